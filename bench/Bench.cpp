@@ -0,0 +1,215 @@
+#include "Bench.hpp"
+#include "IRCCore.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <csignal>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+extern volatile sig_atomic_t g_caught_sig;
+
+static unsigned long volatile g_allocations = 0;
+
+static void* countedAlloc(size_t size)
+{
+	__sync_fetch_and_add(&g_allocations, 1);
+	void* p = std::malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+	return countedAlloc(size);
+}
+
+void* operator new[](size_t size) throw(std::bad_alloc)
+{
+	return countedAlloc(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+	__sync_fetch_and_add(&g_allocations, 1);
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+	__sync_fetch_and_add(&g_allocations, 1);
+	return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* p) throw()
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) throw()
+{
+	std::free(p);
+}
+
+namespace bench {
+
+volatile size_t sink = 0;
+
+double nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+unsigned long allocations()
+{
+	return g_allocations;
+}
+
+void report(const std::string& name, size_t ops, double elapsedNs,
+	const char* unit, unsigned long allocs)
+{
+	double perOp = ops ? elapsedNs / ops : 0;
+	double rate = elapsedNs > 0 ? ops * 1e9 / elapsedNs : 0;
+	double allocsPerOp = ops ? static_cast<double>(allocs) / ops : 0;
+	std::printf("%-40s %12.1f ns/op %14.0f %s/sec %8.2f allocs/op\n",
+		name.c_str(), perOp, rate, unit, allocsPerOp);
+}
+
+// Server thread
+
+static void* serve(void* arg)
+{
+	ServerThread* st = static_cast<ServerThread*>(arg);
+	IRCCore core(st->port, st->password, st->cfg);
+	core.loop();
+	return NULL;
+}
+
+bool startServer(ServerThread& st)
+{
+	g_caught_sig = 0;
+	return pthread_create(&st.thread, NULL, serve, &st) == 0;
+}
+
+void stopServer(ServerThread& st)
+{
+	g_caught_sig = 1;
+	Client nudge;
+	nudge.open(st.port);
+	pthread_join(st.thread, NULL);
+	nudge.close();
+	g_caught_sig = 0;
+}
+
+// Client
+
+Client::Client() : fd(-1)
+{
+}
+
+Client::~Client()
+{
+}
+
+bool Client::open(int port)
+{
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	for (int attempt = 0; attempt < 200; ++attempt)
+	{
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			return false;
+		if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0)
+		{
+			int one = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			return true;
+		}
+		::close(fd);
+		fd = -1;
+		usleep(10000);
+	}
+	return false;
+}
+
+ssize_t Client::write(const char* data, size_t len)
+{
+	return send(fd, data, len, 0);
+}
+
+ssize_t Client::read(char* buf, size_t len)
+{
+	return recv(fd, buf, len, 0);
+}
+
+bool Client::sendAll(const std::string& data)
+{
+	size_t off = 0;
+	while (off < data.size())
+	{
+		ssize_t n = write(data.data() + off, data.size() - off);
+		if (n <= 0)
+			return false;
+		off += n;
+	}
+	return true;
+}
+
+bool Client::expect(const char* token, size_t count)
+{
+	size_t tlen = std::strlen(token);
+	std::string acc;
+	size_t seen = 0;
+	char buf[16384];
+	while (seen < count)
+	{
+		ssize_t n = read(buf, sizeof(buf));
+		if (n <= 0)
+			return false;
+		acc.append(buf, n);
+		size_t from = 0;
+		size_t pos;
+		while ((pos = acc.find(token, from)) != std::string::npos)
+		{
+			++seen;
+			from = pos + tlen;
+		}
+		// Keep only what could still start a token
+		if (acc.size() - from >= tlen)
+			from = acc.size() - tlen + 1;
+		acc.erase(0, from);
+	}
+	return true;
+}
+
+void Client::close()
+{
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+#include <pthread.h>
+#include "Config.hpp"
+
+// Minimal harness: each case runs its body `iterations` times between two
+// monotonic clock reads and prints ns/op, ops/sec and heap allocations/op.
+namespace bench {
+
+double nowNs();
+// operator new calls made by the whole process so far (Bench.cpp replaces
+// the global allocation functions to count them)
+unsigned long allocations();
+void report(const std::string& name, size_t ops, double elapsedNs,
+            const char* unit, unsigned long allocs);
+
+// Written by benchmark bodies so the optimizer cannot drop their work
+extern volatile size_t sink;
+
+// End-to-end fixtures: a server running in a thread of this process, and
+// blocking loopback clients to drive it
+struct ServerThread {
+    int             port;
+    std::string     password;
+    ServerConfig    cfg;
+    pthread_t       thread;
+};
+
+bool startServer(ServerThread& st);
+// The loop notices the stop flag on its next wakeup, which a throwaway
+// connection provides; close the clients first
+void stopServer(ServerThread& st);
+
+// Plain TCP; TlsBench layers SSL over read() and write(). Copyable, and
+// the socket stays open until close().
+class Client {
+    protected:
+        virtual ssize_t write(const char* data, size_t len);
+        virtual ssize_t read(char* buf, size_t len);
+
+    public:
+        int     fd;
+
+        Client();
+        virtual ~Client();
+
+        // Retries while the server thread is not listening yet
+        bool open(int port);
+        bool sendAll(const std::string& data);
+        // Reads until `count` occurrences of `token` have arrived
+        bool expect(const char* token, size_t count);
+        virtual void close();
+};
+
+void runParserBench(size_t scale);
+void runCoreBench(size_t scale);
+void runIoBench(size_t scale);
+void runTlsBench(size_t scale);
+
+}
+
+#endif
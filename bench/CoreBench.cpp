@@ -0,0 +1,285 @@
+#include "Bench.hpp"
+#include "IRCCore.hpp"
+#include <sstream>
+
+// Sessions here have no socket. Their descriptors are far above any real
+// one, so the close() in IRCCore::shutdown() only gets EBADF.
+static const int kFakeFd = 1 << 20;
+
+// Accumulates time and allocations over the measured parts of a case,
+// leaving out the resets between batches
+struct Meter {
+	double          ns;
+	unsigned long   allocs;
+	double          t0;
+	unsigned long   a0;
+
+	Meter() : ns(0), allocs(0), t0(0), a0(0) {}
+	void start() { a0 = bench::allocations(); t0 = bench::nowNs(); }
+	void stop()
+	{
+		ns += bench::nowNs() - t0;
+		allocs += bench::allocations() - a0;
+	}
+};
+
+// Drives the command handlers of an offline IRCCore: rooms of 10, 100 and
+// 1000 members, with every reply left queued until the next reset
+class CoreBench {
+    private:
+        IRCCore     _core;
+        size_t      _scale;
+        Session*    _alice;     // in every room
+        Session*    _bob;
+        Session*    _guest;     // in no room
+
+        Session* addSession(const std::string& nick);
+        Room* fillRoom(const std::string& label, size_t members);
+        void reset();
+
+        void dispatchCase(const std::string& name, Session* from,
+                          const std::string& line, size_t ops);
+        void joinPartCase(const std::string& label, size_t ops);
+        void splitCase(size_t ops);
+        void relayCase(Room* room, size_t ops);
+        void queueCases(size_t ops);
+        void namesCase(Room* room, size_t ops);
+
+    public:
+        CoreBench(const ServerConfig& cfg, size_t scale);
+        void run();
+};
+
+CoreBench::CoreBench(const ServerConfig& cfg, size_t scale)
+	: _core(cfg), _scale(scale), _alice(NULL), _bob(NULL), _guest(NULL)
+{
+}
+
+Session* CoreBench::addSession(const std::string& nick)
+{
+	int fd = kFakeFd + static_cast<int>(_core._sessions.size());
+	Session* s = new Session(fd, &_core._pendingWrites);
+	s->markPassOk(true);
+	s->setNick(nick);
+	s->setUser(nick);
+	s->markWelcomed(true);
+	_core._sessions[fd] = s;
+	_core._nickIndex.set(nick, s);
+	return s;
+}
+
+Room* CoreBench::fillRoom(const std::string& label, size_t members)
+{
+	_core.joinOneChannel(*_alice, label, "");
+	for (size_t i = 1; i < members; ++i)
+	{
+		std::ostringstream nick;
+		nick << "m" << label.substr(1) << "_" << i;
+		_core.joinOneChannel(*addSession(nick.str()), label, "");
+	}
+	reset();
+	return _core._rooms[label];
+}
+
+// Drops every queued reply, as a write pass would
+void CoreBench::reset()
+{
+	for (std::map<int, Session*>::iterator it = _core._sessions.begin();
+		it != _core._sessions.end(); ++it)
+	{
+		it->second->getOutQueue().clear();
+		it->second->clearDirty();
+	}
+	_core._pendingWrites.clear();
+}
+
+void CoreBench::dispatchCase(const std::string& name, Session* from,
+	const std::string& line, size_t ops)
+{
+	StrView view(line);
+	Meter m;
+	for (size_t done = 0; done < ops; done += 64)
+	{
+		m.start();
+		for (size_t i = 0; i < 64; ++i)
+			_core.dispatch(*from, view);
+		m.stop();
+		reset();
+	}
+	bench::report("dispatch " + name, ops, m.ns, "cmds", m.allocs);
+}
+
+void CoreBench::joinPartCase(const std::string& label, size_t ops)
+{
+	std::string joinLine = "JOIN " + label;
+	std::string partLine = "PART " + label;
+	StrView join(joinLine);
+	StrView part(partLine);
+
+	Meter m;
+	for (size_t done = 0; done < ops; done += 16)
+	{
+		m.start();
+		for (size_t i = 0; i < 16; ++i)
+		{
+			_core.dispatch(*_guest, join);
+			_core.dispatch(*_guest, part);
+		}
+		m.stop();
+		reset();
+	}
+	size_t members = _core._rooms[label]->getUserList().size();
+	std::ostringstream name;
+	name << "dispatch JOIN+PART (" << members << " members)";
+	bench::report(name.str(), ops, m.ns, "pairs", m.allocs);
+}
+
+void CoreBench::splitCase(size_t ops)
+{
+	std::string list = "#alpha,#beta,#gamma,#delta";
+	StrView view(list);
+	size_t acc = 0;
+	Meter m;
+	m.start();
+	for (size_t i = 0; i < ops; ++i)
+		acc += _core.splitComma(view).size();
+	m.stop();
+	bench::sink = bench::sink + acc;
+	bench::report("splitComma 4 channels", ops, m.ns, "lists", m.allocs);
+}
+
+void CoreBench::relayCase(Room* room, size_t ops)
+{
+	std::string line = ":alice!alice@localhost PRIVMSG " + room->getLabel()
+		+ " :the quick brown fox jumps over the lazy dog\r\n";
+	size_t batch = 64;
+	Meter m;
+	for (size_t done = 0; done < ops; done += batch)
+	{
+		m.start();
+		for (size_t i = 0; i < batch; ++i)
+			room->relay(line, _alice);
+		m.stop();
+		reset();
+	}
+	std::ostringstream name;
+	name << "Room::relay " << room->getUserList().size() << " members";
+	bench::report(name.str(), ops, m.ns, "lines", m.allocs);
+}
+
+// Session::pushToOutBuf for a private reply and for a shared broadcast
+// line, then draining a mixed queue the way a write does, minus the
+// syscall
+void CoreBench::queueCases(size_t ops)
+{
+	std::string reply = ":ft_irc 001 alice :Welcome to the ft_irc Network\r\n";
+	BufRef shared(std::string(":bob!bob@localhost PRIVMSG #r :hello world\r\n"));
+	Meter m;
+
+	for (size_t done = 0; done < ops; done += 1024)
+	{
+		m.start();
+		for (size_t i = 0; i < 1024; ++i)
+			_bob->pushToOutBuf(reply);
+		m.stop();
+		reset();
+	}
+	bench::report("Session::pushToOutBuf reply", ops, m.ns, "pushes", m.allocs);
+
+	m = Meter();
+	for (size_t done = 0; done < ops; done += 1024)
+	{
+		m.start();
+		for (size_t i = 0; i < 1024; ++i)
+			_bob->pushToOutBuf(shared);
+		m.stop();
+		reset();
+	}
+	bench::report("Session::pushToOutBuf shared line", ops, m.ns, "pushes", m.allocs);
+
+	// 32 broadcast lines interleaved with 32 replies per drained queue
+	m = Meter();
+	size_t drains = ops / 64;
+	struct iovec iov[64];
+	OutQueue& out = _bob->getOutQueue();
+	for (size_t d = 0; d < drains; ++d)
+	{
+		for (size_t i = 0; i < 32; ++i)
+		{
+			_bob->pushToOutBuf(shared);
+			_bob->pushToOutBuf(reply);
+		}
+		m.start();
+		while (!out.empty())
+		{
+			size_t count = out.gather(iov, 64);
+			size_t bytes = 0;
+			for (size_t i = 0; i < count; ++i)
+				bytes += iov[i].iov_len;
+			out.consume(bytes);
+		}
+		m.stop();
+		reset();
+	}
+	bench::report("OutQueue drain 64 lines (no syscall)", drains, m.ns, "queues", m.allocs);
+}
+
+void CoreBench::namesCase(Room* room, size_t ops)
+{
+	Meter m;
+	for (size_t done = 0; done < ops; done += 16)
+	{
+		m.start();
+		for (size_t i = 0; i < 16; ++i)
+			_core.sendNames(*_alice, room);
+		m.stop();
+		reset();
+	}
+	std::ostringstream name;
+	name << "NAMES reply " << room->getUserList().size() << " members";
+	bench::report(name.str(), ops, m.ns, "replies", m.allocs);
+}
+
+void CoreBench::run()
+{
+	_alice = addSession("alice");
+	_bob = addSession("bob");
+	_guest = addSession("guest");
+	Room* r10 = fillRoom("#r10", 10);
+	Room* r100 = fillRoom("#r100", 100);
+	Room* r1000 = fillRoom("#r1000", 1000);
+
+	size_t base = 200000 * _scale;
+	dispatchCase("PING", _alice, "PING :bench", base);
+	dispatchCase("unknown command", _alice, "FROB #r10 :x", base);
+	dispatchCase("PRIVMSG nick", _alice, "PRIVMSG bob :hello there", base);
+	dispatchCase("PRIVMSG #room (10 members)", _alice,
+		"PRIVMSG #r10 :the quick brown fox", base);
+	dispatchCase("PRIVMSG #room (100 members)", _alice,
+		"PRIVMSG #r100 :the quick brown fox", base / 4);
+	dispatchCase("MODE #room query", _alice, "MODE #r100", base);
+	joinPartCase("#r100", base / 20);
+
+	splitCase(base);
+
+	relayCase(r10, base);
+	relayCase(r100, base / 4);
+	relayCase(r1000, base / 40);
+
+	queueCases(base * 4);
+
+	namesCase(r100, base / 20);
+	namesCase(r1000, base / 100);
+}
+
+namespace bench {
+
+void runCoreBench(size_t scale)
+{
+	ServerConfig cfg;
+	cfg.flood.rate = 0;
+	CoreBench core(cfg, scale);
+	core.run();
+}
+
+}
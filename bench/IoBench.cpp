@@ -0,0 +1,93 @@
+#include "Bench.hpp"
+#include "Uring.hpp"
+#include <cstdio>
+#include <vector>
+
+namespace bench {
+
+// Event backends compared end to end: a server runs in a thread of this
+// process and blocking loopback clients drive it. Every round, all clients
+// send a PING before any reply is read, so one loop tick sees them all at
+// once -- the case where io_uring saves a syscall per client.
+static const int kBasePort = 26670;
+static const char* kPassword = "bench";
+
+static void runBackend(const char* backend, int port, size_t clients, size_t rounds)
+{
+	ServerThread st;
+	st.port = port;
+	st.password = kPassword;
+	st.cfg.ioBackend = backend;
+	st.cfg.flood.rate = 0;
+	if (!startServer(st))
+		return;
+
+	std::vector<Client> conns;
+	bool ok = true;
+	for (size_t i = 0; ok && i < clients; ++i)
+	{
+		Client c;
+		char nick[16];
+		std::snprintf(nick, sizeof(nick), "b%lu", static_cast<unsigned long>(i));
+		ok = c.open(port);
+		if (ok)
+			conns.push_back(c);
+		ok = ok && c.sendAll(std::string("PASS ") + kPassword
+			+ "\r\nNICK " + nick + "\r\nUSER " + nick + " 0 * :bench\r\n")
+			&& c.expect(" 001 ", 1);
+	}
+
+	std::string ping("PING :rtt\r\n");
+	unsigned long allocs = allocations();
+	double start = nowNs();
+	for (size_t r = 0; ok && r < rounds; ++r)
+	{
+		for (size_t i = 0; ok && i < conns.size(); ++i)
+			ok = conns[i].sendAll(ping);
+		for (size_t i = 0; ok && i < conns.size(); ++i)
+			ok = conns[i].expect("PONG", 1);
+	}
+	double elapsed = nowNs() - start;
+	// Server thread and clients together
+	allocs = allocations() - allocs;
+
+	if (ok)
+	{
+		char name[64];
+		std::snprintf(name, sizeof(name), "%s PING round trip x%lu", backend,
+			static_cast<unsigned long>(clients));
+		report(name, rounds * clients, elapsed, "msgs", allocs);
+	}
+	else
+		std::printf("%-40s failed\n", backend);
+
+	for (size_t i = 0; i < conns.size(); ++i)
+		conns[i].close();
+	stopServer(st);
+}
+
+void runIoBench(size_t scale)
+{
+	static const size_t kClients[] = { 1, 64, 512 };
+	const char* backends[] = { "poll", "epoll", "uring" };
+
+	Uring probe;
+	bool haveUring = probe.init(8, 8, 64);
+
+	int port = kBasePort;
+	for (size_t c = 0; c < sizeof(kClients) / sizeof(kClients[0]); ++c)
+	{
+		size_t rounds = 20000 * scale / kClients[c] + 1;
+		for (size_t b = 0; b < 3; ++b)
+		{
+			if (b == 2 && !haveUring)
+			{
+				std::printf("%-40s skipped (io_uring unavailable)\n", backends[b]);
+				continue;
+			}
+			runBackend(backends[b], port++, kClients[c], rounds);
+		}
+	}
+}
+
+}
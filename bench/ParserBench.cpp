@@ -0,0 +1,57 @@
+#include "Bench.hpp"
+#include "IrcMessage.hpp"
+#include <vector>
+
+namespace bench {
+
+static const char* kCorpus[] = {
+	"PRIVMSG #general :hello everyone, how is it going today?",
+	"JOIN #a,#b,#c key1,key2",
+	"MODE #general +ok-l secret alice",
+	"PING :ft_irc",
+	"USER alice 0 * :Alice Liddell",
+	"@time=2024-01-01T00:00:00.000Z;msgid=abc :alice!a@host PRIVMSG bob :hi",
+	"KICK #general bob :flooding the channel",
+	"NICK alice_"
+};
+
+static void parseLines(const std::string& name, const std::vector<StrView>& lines,
+	size_t rounds)
+{
+	IrcMessage msg;
+	size_t acc = 0;
+	unsigned long allocs = allocations();
+	double start = nowNs();
+	for (size_t r = 0; r < rounds; ++r)
+	{
+		for (size_t i = 0; i < lines.size(); ++i)
+		{
+			parseMessage(lines[i], msg);
+			acc += msg.paramCount + msg.command.size();
+		}
+	}
+	double elapsed = nowNs() - start;
+	allocs = allocations() - allocs;
+	sink = sink + acc;
+	report(name, rounds * lines.size(), elapsed, "lines", allocs);
+}
+
+void runParserBench(size_t scale)
+{
+	size_t count = sizeof(kCorpus) / sizeof(kCorpus[0]);
+	size_t rounds = 250000 * scale;
+
+	std::vector<StrView> mixed;
+	for (size_t i = 0; i < count; ++i)
+		mixed.push_back(StrView(kCorpus[i]));
+	parseLines("parseMessage mixed corpus", mixed, rounds);
+
+	for (size_t i = 0; i < count; i += 3)
+	{
+		std::vector<StrView> one(1, StrView(kCorpus[i]));
+		parseLines("parseMessage " + StrView(kCorpus[i]).substr(0, 12).str() + "...",
+			one, rounds * 4);
+	}
+}
+
+}
@@ -0,0 +1,234 @@
+#include "Bench.hpp"
+#include <cstdio>
+
+#ifndef IRC_TLS
+
+namespace bench {
+
+void runTlsBench(size_t)
+{
+	std::printf("%-40s skipped (built without OpenSSL)\n", "tls relay");
+}
+
+}
+
+#else
+
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/pem.h>
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <unistd.h>
+#include <pthread.h>
+
+namespace bench {
+
+// Relay throughput over the TLS port against the plaintext one: a sender
+// streams PRIVMSGs to a receiver through a server running in a thread of
+// this process, so the numbers include the server decrypting every line
+// and encrypting it again. The clients ask for kTLS too; whether their
+// sockets got it shows whether the kernel offers it at all.
+static const int kPort = 26700;
+static const char* kPassword = "bench";
+static const char* kCertFile = "/tmp/ircbench-cert.pem";
+static const char* kKeyFile = "/tmp/ircbench-key.pem";
+static const size_t kBatch = 64;
+
+// Self-signed P-256 certificate, good for a day
+static bool makeCertificate()
+{
+	EVP_PKEY* key = NULL;
+	EVP_PKEY_CTX* kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+	bool ok = kctx && EVP_PKEY_keygen_init(kctx) == 1
+		&& EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, NID_X9_62_prime256v1) == 1
+		&& EVP_PKEY_keygen(kctx, &key) == 1;
+	EVP_PKEY_CTX_free(kctx);
+
+	X509* cert = ok ? X509_new() : NULL;
+	if (cert)
+	{
+		X509_set_version(cert, 2);
+		ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+		X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+		X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+		X509_NAME* name = X509_get_subject_name(cert);
+		X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+			reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+		X509_set_issuer_name(cert, name);
+		ok = X509_set_pubkey(cert, key) == 1 && X509_sign(cert, key, EVP_sha256()) > 0;
+	}
+
+	FILE* f;
+	if (ok && (f = std::fopen(kKeyFile, "w")) != NULL)
+	{
+		ok = PEM_write_PrivateKey(f, key, NULL, NULL, 0, NULL, NULL) == 1;
+		std::fclose(f);
+	}
+	if (ok && (f = std::fopen(kCertFile, "w")) != NULL)
+	{
+		ok = PEM_write_X509(f, cert) == 1;
+		std::fclose(f);
+	}
+	X509_free(cert);
+	EVP_PKEY_free(key);
+	return ok;
+}
+
+// The same client with SSL over its socket; plain when opened without a
+// context
+class TlsClient : public Client {
+	private:
+		SSL*    _ssl;
+
+	protected:
+		ssize_t write(const char* data, size_t len)
+		{
+			if (!_ssl)
+				return Client::write(data, len);
+			return SSL_write(_ssl, data, static_cast<int>(len));
+		}
+
+		ssize_t read(char* buf, size_t len)
+		{
+			if (!_ssl)
+				return Client::read(buf, len);
+			return SSL_read(_ssl, buf, static_cast<int>(len));
+		}
+
+	public:
+		TlsClient() : _ssl(NULL) {}
+
+		bool open(int port, SSL_CTX* ctx)
+		{
+			if (!Client::open(port))
+				return false;
+			if (!ctx)
+				return true;
+			_ssl = SSL_new(ctx);
+			return _ssl && SSL_set_fd(_ssl, fd) == 1 && SSL_connect(_ssl) == 1;
+		}
+
+		bool kernelTls() const
+		{
+			return _ssl && BIO_get_ktls_send(SSL_get_wbio(_ssl))
+				&& BIO_get_ktls_recv(SSL_get_rbio(_ssl));
+		}
+
+		void close()
+		{
+			if (_ssl)
+				SSL_free(_ssl);
+			_ssl = NULL;
+			Client::close();
+		}
+};
+
+struct Receiver {
+	TlsClient*  client;
+	size_t      lines;
+	bool        ok;
+};
+
+static void* receive(void* arg)
+{
+	Receiver* r = static_cast<Receiver*>(arg);
+	r->ok = r->client->expect("PRIVMSG", r->lines);
+	return NULL;
+}
+
+static bool registerAs(TlsClient& c, const char* nick)
+{
+	return c.sendAll(std::string("PASS ") + kPassword + "\r\nNICK " + nick
+		+ "\r\nUSER " + nick + " 0 * :bench\r\n") && c.expect(" 001 ", 1);
+}
+
+static void runRelay(const char* name, int port, SSL_CTX* ctx, size_t lines)
+{
+	ServerThread st;
+	st.port = port;
+	st.password = kPassword;
+	st.cfg.ioBackend = "epoll";
+	st.cfg.flood.rate = 0;
+	st.cfg.tlsPort = port + 1;
+	st.cfg.tlsCert = kCertFile;
+	st.cfg.tlsKey = kKeyFile;
+	if (!startServer(st))
+		return;
+
+	int target = ctx ? port + 1 : port;
+	TlsClient tx, rx;
+	bool ok = rx.open(target, ctx) && registerAs(rx, "rx")
+		&& tx.open(target, ctx) && registerAs(tx, "tx");
+
+	std::string batch;
+	std::string payload(400, 'x');
+	for (size_t i = 0; i < kBatch; ++i)
+		batch += "PRIVMSG rx :" + payload + "\r\n";
+
+	Receiver r;
+	r.client = &rx;
+	r.lines = (lines + kBatch - 1) / kBatch * kBatch;
+	r.ok = false;
+	pthread_t reader;
+	unsigned long allocs = allocations();
+	double start = nowNs();
+	if (ok && pthread_create(&reader, NULL, receive, &r) == 0)
+	{
+		for (size_t sent = 0; ok && sent < r.lines; sent += kBatch)
+			ok = tx.sendAll(batch);
+		pthread_join(reader, NULL);
+		ok = ok && r.ok;
+	}
+	else
+		ok = false;
+	double elapsed = nowNs() - start;
+	allocs = allocations() - allocs;
+
+	if (ok)
+	{
+		char label[64];
+		std::snprintf(label, sizeof(label), "%s relay%s", name,
+			!ctx ? "" : (rx.kernelTls() ? " (kTLS)" : " (user-space TLS)"));
+		report(label, r.lines, elapsed, "msgs", allocs);
+		double bytes = static_cast<double>(r.lines) * (batch.size() / kBatch);
+		std::printf("%-40s %12.1f MB/s\n", "", bytes / (elapsed / 1e9) / 1e6);
+	}
+	else
+		std::printf("%-40s failed\n", name);
+
+	tx.close();
+	rx.close();
+	stopServer(st);
+}
+
+void runTlsBench(size_t scale)
+{
+	if (!makeCertificate())
+	{
+		std::printf("%-40s skipped (could not create a certificate)\n", "tls relay");
+		return;
+	}
+
+	SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+	if (!ctx)
+		return;
+# ifdef SSL_OP_ENABLE_KTLS
+	SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+# endif
+
+	size_t lines = 50000 * scale;
+	runRelay("plaintext", kPort, NULL, lines);
+	runRelay("TLS 1.3", kPort + 2, ctx, lines);
+	// Before OpenSSL 3.2 kTLS receive only works for TLS 1.2
+	SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+	runRelay("TLS 1.2", kPort + 4, ctx, lines);
+
+	SSL_CTX_free(ctx);
+	unlink(kCertFile);
+	unlink(kKeyFile);
+}
+
+}
+
+#endif
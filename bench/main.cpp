@@ -0,0 +1,33 @@
+#include "Bench.hpp"
+#include "Logger.hpp"
+#include <cstdlib>
+#include <cstdio>
+#include <csignal>
+
+// Defined by srcs/main.cpp in the server binary
+volatile sig_atomic_t g_caught_sig = 0;
+
+int main(int argc, char** argv)
+{
+	size_t scale = 1;
+	if (argc > 1)
+		scale = std::atoi(argv[1]) > 0 ? std::atoi(argv[1]) : 1;
+
+	// Only warnings: the handlers log every JOIN and connection at info
+	Logger::start(LOG_WARN);
+
+	std::printf("== parser ==\n");
+	bench::runParserBench(scale);
+
+	std::printf("\n== core ==\n");
+	bench::runCoreBench(scale);
+
+	std::printf("\n== io backends ==\n");
+	bench::runIoBench(scale);
+
+	std::printf("\n== tls ==\n");
+	bench::runTlsBench(scale);
+
+	Logger::stop();
+	return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef ADMISSION_HPP
+#define ADMISSION_HPP
+
+#include <stdint.h>
+#include "Config.hpp"
+#include "HashMap.hpp"
+#include "TimerWheel.hpp"
+
+// HashMap traits for IPv4 addresses in host order. Neighbouring addresses
+// differ in the low bits the table indexes with, so they are mixed first.
+struct AddrTraits {
+    static size_t hash(const uint32_t& addr);
+    static bool equal(const uint32_t& a, const uint32_t& b);
+};
+
+// Per-address connection admission (--max-per-ip, --connect-rate). Each
+// address with a limit to enforce has one table entry: its open
+// connections, and connects over the last window, estimated from two
+// fixed windows weighted by how far the current one has run. Entries with
+// nothing open are dropped once their history no longer matters, by a
+// timer rather than a sweep. Core thread only.
+class Admission {
+    public:
+        enum Verdict { ADMIT, TOO_MANY, TOO_FAST };
+
+    private:
+        struct Host {
+            uint32_t        addr;
+            unsigned int    open;
+            unsigned int    current;    // connects in the window at start
+            unsigned int    previous;   // connects in the window before
+            long            start;
+            Timer           expiry;     // armed while nothing is open
+
+            Host();
+        };
+
+        AdmissionLimits                         _limits;
+        long                                    _windowMs;
+        TimerWheel                              _expiry;    // outlives _hosts
+        HashMap<uint32_t, Host, AddrTraits>     _hosts;
+
+        // Non-copyable
+        Admission(const Admission&);
+        Admission& operator=(const Admission&);
+
+        bool exempt(uint32_t addr) const;
+        void roll(Host& h, long now) const;
+        unsigned int recent(const Host& h, long now) const;
+
+    public:
+        Admission(const AdmissionLimits& limits, long nowMs);
+
+        bool enabled() const;
+        // Counts the connection when it is admitted
+        Verdict admit(uint32_t addr, long nowMs);
+        // One connection from addr closed; addresses never admitted are
+        // ignored
+        void release(uint32_t addr, long nowMs);
+        // Forgets idle addresses whose window has passed
+        void expire(long nowMs);
+        size_t tracked() const;
+};
+
+#endif
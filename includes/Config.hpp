@@ -0,0 +1,76 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#include "Logger.hpp"
+
+// Per-session send queue bounds, in bytes: above `high` the server stops
+// reading from the client, below `low` it reads again, past `max` the
+// client is disconnected
+struct SendQLimits {
+    size_t  low;
+    size_t  high;
+    size_t  max;
+};
+
+// Per-session command budget: a bucket of `burst` tokens refilled at
+// `rate` tokens per second; each command costs its CommandSpec::floodCost.
+// A rate of 0 turns flood control off.
+struct FloodLimits {
+    unsigned int    burst;
+    unsigned int    rate;
+};
+
+// Connection deadlines, in seconds; 0 turns one off
+struct Timeouts {
+    unsigned int    pingInterval;   // server PING to every registered client
+    unsigned int    pingTimeout;    // PONG due within this long
+    unsigned int    registration;   // PASS, NICK and USER done within this long
+    unsigned int    idle;           // no command besides PING and PONG
+};
+
+// IPv4 range in host byte order
+struct CidrRange {
+    uint32_t    net;
+    uint32_t    mask;
+};
+
+// Per-address connection limits; 0 turns one off. Addresses in an exempt
+// range are never limited.
+struct AdmissionLimits {
+    unsigned int            maxPerIp;   // open connections
+    unsigned int            rate;       // new connections per window
+    unsigned int            window;     // seconds
+    std::vector<CidrRange>  exempt;
+};
+
+// Optional startup settings, filled from the command line after <port> <password>
+struct ServerConfig {
+    std::string ioBackend;
+    int         ioThreads;
+    size_t      preallocSessions;   // slab slots reserved at startup
+    size_t      preallocRooms;
+    LogLevel    logLevel;
+    int         listenBacklog;
+    int         acceptBatch;        // connections accepted per loop tick
+    SendQLimits sendq;
+    FloodLimits flood;
+    Timeouts    timeouts;
+    AdmissionLimits admission;
+    int         tlsPort;            // 0: no TLS listener
+    std::string tlsCert;            // PEM certificate chain
+    std::string tlsKey;             // PEM private key
+    int         metricsPort;        // 0: no metrics endpoint
+    std::string operPassword;       // empty: OPER disabled
+    bool        commandTiming;      // per-command handler latency
+
+    ServerConfig();
+};
+
+bool parseServerOptions(int argc, char** argv, int first, ServerConfig& cfg);
+void printServerOptions(const char* prog);
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef HASHMAP_HPP
+#define HASHMAP_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Separate-chaining hash table for the hot lookups (C++98 has no
+// unordered_map). Traits supplies `static size_t hash(const K&)` and
+// `static bool equal(const K&, const K&)`, so keys can be hashed under a
+// custom equivalence (e.g. IRC casemapping) without building new keys.
+// The bucket array doubles when the load factor reaches 1.
+template <typename K, typename V, typename Traits>
+class HashMap {
+    private:
+        struct Node {
+            K       key;
+            V       value;
+            Node*   next;
+            Node(const K& k, const V& v) : key(k), value(v), next(NULL) {}
+        };
+
+        std::vector<Node*>  _buckets;
+        size_t              _size;
+
+        // Non-copyable
+        HashMap(const HashMap&);
+        HashMap& operator=(const HashMap&);
+
+        size_t slot(const K& key, size_t count) const
+        {
+            return Traits::hash(key) & (count - 1);
+        }
+
+        void grow()
+        {
+            std::vector<Node*> next(_buckets.size() * 2, (Node*)NULL);
+            for (size_t i = 0; i < _buckets.size(); ++i)
+            {
+                Node* n = _buckets[i];
+                while (n)
+                {
+                    Node* after = n->next;
+                    size_t s = slot(n->key, next.size());
+                    n->next = next[s];
+                    next[s] = n;
+                    n = after;
+                }
+            }
+            _buckets.swap(next);
+        }
+
+    public:
+        explicit HashMap(size_t buckets = 16) : _size(0)
+        {
+            size_t n = 1;
+            while (n < buckets)
+                n *= 2;
+            _buckets.assign(n, (Node*)NULL);
+        }
+
+        ~HashMap() { clear(); }
+
+        size_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+
+        V* find(const K& key)
+        {
+            Node* n = _buckets[slot(key, _buckets.size())];
+            while (n && !Traits::equal(n->key, key))
+                n = n->next;
+            return n ? &n->value : NULL;
+        }
+
+        const V* find(const K& key) const
+        {
+            return const_cast<HashMap*>(this)->find(key);
+        }
+
+        // Inserts or overwrites; returns the stored value
+        V& set(const K& key, const V& value)
+        {
+            V* existing = find(key);
+            if (existing)
+            {
+                *existing = value;
+                return *existing;
+            }
+            if (_size >= _buckets.size())
+                grow();
+            size_t s = slot(key, _buckets.size());
+            Node* n = new Node(key, value);
+            n->next = _buckets[s];
+            _buckets[s] = n;
+            ++_size;
+            return n->value;
+        }
+
+        bool erase(const K& key)
+        {
+            Node** link = &_buckets[slot(key, _buckets.size())];
+            while (*link && !Traits::equal((*link)->key, key))
+                link = &(*link)->next;
+            if (!*link)
+                return false;
+            Node* dead = *link;
+            *link = dead->next;
+            delete dead;
+            --_size;
+            return true;
+        }
+
+        void clear()
+        {
+            for (size_t i = 0; i < _buckets.size(); ++i)
+            {
+                Node* n = _buckets[i];
+                while (n)
+                {
+                    Node* after = n->next;
+                    delete n;
+                    n = after;
+                }
+                _buckets[i] = NULL;
+            }
+            _size = 0;
+        }
+
+        // Calls fn(key, value) for every entry; fn must not modify the map
+        template <typename Fn>
+        void forEach(Fn& fn) const
+        {
+            for (size_t i = 0; i < _buckets.size(); ++i)
+                for (Node* n = _buckets[i]; n; n = n->next)
+                    fn(n->key, n->value);
+        }
+};
+
+// Identity traits for pointer keys; the low bits are alignment padding
+template <typename T>
+struct PointerTraits {
+    static size_t hash(T* const& p)
+    {
+        size_t h = reinterpret_cast<size_t>(p);
+        return (h >> 4) ^ (h >> 12) ^ (h >> 20);
+    }
+    static bool equal(T* const& a, T* const& b) { return a == b; }
+};
+
+#endif
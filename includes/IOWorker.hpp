@@ -0,0 +1,100 @@
+#ifndef IOWORKER_HPP
+#define IOWORKER_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "Mailbox.hpp"
+#include "Poller.hpp"
+#include "OutQueue.hpp"
+#include "Config.hpp"
+
+// Unit of traffic between the core thread and the I/O threads.
+// connId tells a reused fd number apart from the connection it replaced.
+struct IOMessage {
+    enum Kind {
+        ADOPT,      // core -> worker: start serving this fd
+        SEND,       // core -> worker: append data to the fd's output
+        CLOSE,      // core -> worker: close the fd, drop pending output
+        STOP,       // core -> worker: close everything and exit
+        DATA,       // worker -> core: bytes received
+        HANGUP      // worker -> core: peer closed, socket error or
+                    // eviction (data then holds the QUIT reason)
+    };
+
+    Kind            kind;
+    int             fd;
+    unsigned long   connId;
+    std::string     data;       // DATA payload, HANGUP reason
+    OutQueue        out;        // SEND payload, shared chunks
+    IOMessage*      next;
+
+    IOMessage(Kind k, int f, unsigned long id);
+};
+
+// One reactor thread: owns a subset of client sockets and performs all
+// recv/send on them. Commands are still executed by the core thread,
+// which is the only one touching sessions and rooms.
+class IOWorker {
+    private:
+        struct Conn {
+            unsigned long   id;
+            OutQueue        out;
+            int             interest;   // IO_* flags registered
+            bool            paused;     // not reading: queue above high
+            bool            dead;
+        };
+
+        int                     _index;
+        std::string             _backend;
+        SendQLimits             _limits;
+        pthread_t               _thread;
+        bool                    _started;
+        bool                    _running;
+        bool volatile           _failed;    // backend broken, thread gone
+        Poller*                 _poller;
+        Mailbox<IOMessage>      _inbox;
+        Doorbell                _bell;
+        Mailbox<IOMessage>&     _coreInbox;
+        Doorbell&               _coreBell;
+        std::map<int, Conn*>    _conns;
+        std::vector<IOEvent>    _events;
+        // Written by this thread only, read by the core for statistics
+        size_t volatile         _queuedBytes;
+        size_t volatile         _peakQueue;
+        size_t volatile         _pausedConns;
+        unsigned long volatile  _evicted;
+
+        // Non-copyable
+        IOWorker(const IOWorker&);
+        IOWorker& operator=(const IOWorker&);
+
+        static void* entry(void* self);
+        void run();
+        void fail();
+        void handleInbox();
+        void onReadable(int fd, Conn& conn);
+        void flushConn(int fd, Conn& conn);
+        void updateInterest(int fd, Conn& conn);
+        void trackDepth(Conn& conn, size_t before);
+        void applyLimits(int fd, Conn& conn);
+        void forget(Conn& conn);
+        void hangup(int fd, Conn& conn, const char* reason = NULL);
+        void toCore(IOMessage* msg);
+
+    public:
+        IOWorker(int index, const std::string& backend,
+                 const SendQLimits& limits,
+                 Mailbox<IOMessage>& coreInbox, Doorbell& coreBell);
+        ~IOWorker();
+
+        bool start();
+        void stop();
+        void post(IOMessage* msg);
+        int  getIndex() const;
+        bool failed() const;
+        SendQStats sendqStats() const;
+};
+
+#endif
@@ -4,9 +4,32 @@
 #include <map>
 #include <vector>
 #include <string>
-#include <poll.h>
+#include "Config.hpp"
+#include "Poller.hpp"
+#include "IOWorker.hpp"
+#include "Uring.hpp"
+#include "Metrics.hpp"
+#include "TimerWheel.hpp"
+#include "Admission.hpp"
+#include "Tls.hpp"
 #include "Session.hpp"
 #include "Room.hpp"
+#include "IrcMessage.hpp"
+#include "HashMap.hpp"
+#include "helpers.hpp"
+
+// Acceptor counters
+struct AcceptStats {
+    unsigned long   accepted;       // lifetime total
+    unsigned long   perSecond;      // accepts during the last full second
+    unsigned long   budgetHits;     // ticks that left connections queued
+    unsigned long   overflows;      // kernel ListenOverflows since startup
+    long            windowStart;    // second being counted
+    unsigned long   windowCount;
+    long            overflowBase;   // -1 when the kernel does not report it
+
+    AcceptStats();
+};
 
 class IRCCore {
     private:
@@ -16,77 +39,194 @@ class IRCCore {
         std::string                     _hostname;
         std::map<int, Session*>         _sessions;
         std::map<std::string, Room*>    _rooms;
-        std::vector<struct pollfd>      _watchers;
+        // Every session holding a nickname, registered or not
+        HashMap<std::string, Session*, NickTraits> _nickIndex;
+        ServerConfig                    _config;
+        Poller*                         _poller;        // NULL with --io uring
+        Uring*                          _uring;
+        std::vector<IOEvent>            _events;
+        std::vector<IOWorker*>          _workers;
+        Mailbox<IOMessage>              _coreInbox;
+        Doorbell                        _coreBell;
+        std::vector<int>                _pendingWrites;
+        std::vector<int>                _throttled;     // deferred input
+        long                            _clockMs;       // monotonic, per tick
+        TimerWheel                      _timers;        // session deadlines
+        Admission                       _admission;     // per-address limits
+        unsigned long                   _nextConnId;
+        size_t                          _nextWorker;
+        AcceptStats                     _acceptStats;
+        struct UringSend;
+        std::map<uint64_t, UringSend*>  _uringSends;    // keyed by request tag
+        std::vector<int>                _uringAccepts;  // over the batch
+        SendQStats                      _sendq;         // evictions, peak
+        ServerMetrics&                  _metrics;
+        int                             _metricsSock;   // -1: no endpoint
+        std::map<int, std::string>      _metricsConns;  // fd -> request so far
+        int                             _tlsSock;       // -1: no TLS listener
+        TlsContext                      _tlsContext;
+        // Handler latency per _commands entry (--command-timing)
+        struct CommandTiming {
+            LatencyHistogram    latency;
+            unsigned long       fanout;     // relay deliveries caused
+
+            CommandTiming();
+        };
+        bool                            _timing;
+        std::vector<CommandTiming>      _commandTiming;
         bool                            _active;
 
         // Non-copyable
         IRCCore(const IRCCore&);
         IRCCore& operator=(const IRCCore&);
 
+        // Offline instance for the microbenchmarks, which call the
+        // handlers directly: no listening socket, no event backend
+        explicit IRCCore(const ServerConfig& config);
+        friend class CoreBench;
+
         // Socket setup
         void initSocket();
 
         // Connection lifecycle
-        void onIncomingConnection();
-        void onDataAvailable(int idx);
-        void onReadyToSend(int idx);
-        void dropConnection(int idx);
+        void onIncomingConnection(int listenFd);
+        bool acceptOne(int listenFd);
+        void setupSession(int fd, const struct sockaddr_in& peer,
+                          bool tls = false);
+        bool admitPeer(int fd, uint32_t addr, const char* ip);
+        void rollAcceptWindow(long now);
+        void onDataAvailable(int fd);
+        void ingestData(Session* sess, const char* buf, size_t n);
+        void processInput(Session* sess);
+        void resumeThrottled();
+        int throttleTimeout() const;
+        int loopTimeout() const;
+        void onReadyToSend(int fd);
+        void dropConnection(int fd,
+                            const std::string& reason = "Connection closed");
+
+        // I/O threads (--threads N)
+        void startWorkers();
+        void stopWorkers();
+        int  pickWorker();
+        void handToWorker(Session* sess, int worker);
+        void releaseFromWorker(Session* sess);
+        void onWorkerMessages();
+
+        // io_uring backend (--io uring)
+        void startUring();
+        void stopUring();
+        bool uringListen();
+        bool uringTick();
+        void onUringCompletion(const UringCompletion& c);
+        void uringSetupAccepted();
+        void onUringRecv(const UringCompletion& c);
+        void onUringSend(const UringCompletion& c);
+        void uringSync(Session* sess);
+        void uringRelease(Session* sess);
+        bool uringPollMetrics(int fd);
+        void uringCancelMetrics(int fd);
+
+        // Registration, keepalive and idle deadlines
+        void armTimer(Session& sess);
+        void runTimers();
+        void onSessionTimer(Session* sess);
+
+        // TLS listener (--tls-port)
+        void initTlsSocket();
+        void continueHandshake(Session* sess);
+        void onTlsData(Session* sess);
+        ssize_t writeOut(Session* sess);
+
+        // Metrics endpoint (--metrics-port)
+        void initMetricsSocket();
+        bool watchMetrics(int fd, bool again);
+        void onMetricsConnection();
+        void onMetricsRequest(int fd);
+        void closeMetrics(int fd);
+        void renderMetrics(std::string& out);
 
         // Output helpers
         void enqueueReply(Session& sess, const std::string& data);
         void replyNumeric(Session& sess, const std::string& code, const std::string& body);
         std::string buildPrefix(Session& sess);
         void refreshPollFlags(int fd);
-        void flushRoomBuffers(Room* room, Session* except);
-        std::vector<std::string> splitComma(const std::string& s);
-
-        // Parsing
-        std::string parseVerb(const std::string& raw);
-        std::string parseArgs(const std::string& raw);
+        void flushPendingWrites();
+        bool enforceSendQ(Session* sess);
+        void logPoolStats();
+        void logSendQStats();
+        void logCommandTiming();
+        std::vector<std::string> splitComma(const StrView& s);
 
         // Lookup
         Session* locateByNick(const std::string& nick);
-        void purgeFromRooms(Session* sess);
+        void purgeFromRooms(Session* sess, const std::string& reason);
+        void sendClosingLink(Session* sess, const std::string& reason);
         Room* requireRoom(Session& sess, const std::string& label, bool needOp);
 
         // Command dispatcher
-        void dispatch(Session& sess, const std::string& line);
+        typedef void (IRCCore::*CommandHandler)(Session&, const IrcMessage&);
+        struct CommandSpec {
+            const char*     name;
+            CommandHandler  handler;        // NULL: accepted, ignored
+            size_t          minParams;      // fewer -> 461
+            bool            needsRegistration;
+            unsigned int    floodCost;
+        };
+        static const CommandSpec _commands[];
+        static const size_t _commandCount;
+        static const CommandSpec* findCommand(const IrcMessage& msg);
+        void dispatch(Session& sess, const StrView& line);
+        void timeHandler(Session& sess, const IrcMessage& msg,
+                         const CommandSpec* cmd);
+        std::vector<std::string> commandTimingLines() const;
+        void renderCommandTiming(std::string& out) const;
+        bool floodAllows(const Session& sess) const;
+        void chargeFlood(Session& sess, unsigned int cost);
 
         // Registration commands
-        void cmdPass(Session& sess, const std::string& args);
-        void cmdNick(Session& sess, const std::string& args);
-        void cmdUser(Session& sess, const std::string& args);
+        void cmdPass(Session& sess, const IrcMessage& msg);
+        void cmdNick(Session& sess, const IrcMessage& msg);
+        void cmdUser(Session& sess, const IrcMessage& msg);
         void tryFinalize(Session& sess);
-        void cmdQuit(Session& sess, const std::string& args);
+        void cmdQuit(Session& sess, const IrcMessage& msg);
 
         // Room commands
         void joinOneChannel(Session& sess, const std::string& roomLabel,
                            const std::string& passphrase);
-        void cmdJoin(Session& sess, const std::string& args);
-        void cmdPart(Session& sess, const std::string& args);
-        void cmdNames(Session& sess, const std::string& args);
-        void cmdList(Session& sess, const std::string& args);
+        void cmdJoin(Session& sess, const IrcMessage& msg);
+        void cmdPart(Session& sess, const IrcMessage& msg);
+        void sendNames(Session& sess, Room* room);
+        void cmdNames(Session& sess, const IrcMessage& msg);
+        void cmdList(Session& sess, const IrcMessage& msg);
 
         // Messaging
-        void cmdPrivmsg(Session& sess, const std::string& args);
+        void cmdPrivmsg(Session& sess, const IrcMessage& msg);
 
         // Operator commands
-        void cmdKick(Session& sess, const std::string& args);
-        void cmdInvite(Session& sess, const std::string& args);
-        void cmdTopic(Session& sess, const std::string& args);
-        void cmdMode(Session& sess, const std::string& args);
+        void cmdKick(Session& sess, const IrcMessage& msg);
+        void cmdInvite(Session& sess, const IrcMessage& msg);
+        void cmdTopic(Session& sess, const IrcMessage& msg);
+        void cmdMode(Session& sess, const IrcMessage& msg);
         void showChannelModes(Session& sess, const std::string& target);
         void applyChannelModes(Session& sess, const std::string& target,
-                              const std::string& modeStr,
-                              const std::vector<std::string>& modeArgs);
+                              const IrcMessage& msg);
+
+        // Server operators
+        void cmdOper(Session& sess, const IrcMessage& msg);
+        void cmdStats(Session& sess, const IrcMessage& msg);
+        void sendLagStats(Session& sess);
 
         // Utility
-        void cmdPing(Session& sess, const std::string& args);
+        void cmdPing(Session& sess, const IrcMessage& msg);
+        void cmdPong(Session& sess, const IrcMessage& msg);
 
     public:
-        IRCCore(int port, const std::string& password);
+        IRCCore(int port, const std::string& password,
+                const ServerConfig& config);
         ~IRCCore();
         void loop();
+        SendQStats sendqStats();
         void shutdown();
 };
 
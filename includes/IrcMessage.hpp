@@ -0,0 +1,38 @@
+#ifndef IRCMESSAGE_HPP
+#define IRCMESSAGE_HPP
+
+#include <cstddef>
+#include <string>
+#include "StrView.hpp"
+
+// One tokenized protocol line (RFC 2812 section 2.3.1, plus IRCv3 tags):
+//   ['@' tags SPACE] [':' prefix SPACE] command [params]
+// Every field is a view into the line, so parsing never allocates.
+struct IrcMessage {
+    static const size_t kMaxParams = 15;
+
+    StrView tags;
+    StrView prefix;
+    StrView command;
+    StrView params[kMaxParams];
+    size_t  paramCount;
+    bool    hasTrailing;    // last param was introduced by ':'
+    const char* end;
+
+    IrcMessage();
+
+    // Case-insensitive command match against an upper-case name
+    bool is(const char* name) const;
+    // Upper-cased copy of the command, for replies
+    std::string verb() const;
+    // Param i, or an empty view if absent
+    StrView param(size_t i) const;
+    // Raw text from param i to the end of the line: free text sent by
+    // clients that do not prefix it with ':' stays in one piece
+    StrView rest(size_t i) const;
+};
+
+// Returns false when the line holds no command
+bool parseMessage(const StrView& line, IrcMessage& msg);
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <cstddef>
+#include <string>
+#include <pthread.h>
+#include "StrView.hpp"
+
+enum LogLevel {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR,
+    LOG_OFF
+};
+
+// Asynchronous logger. Producers copy a finished record into a bounded
+// lock-free ring (one sequence number per slot, so any thread may log)
+// and return; a background thread timestamps, formats and writes whole
+// batches, and sleeps on a condition variable while the ring is empty.
+// Producers only take its mutex to wake it. A full ring drops the record
+// and counts it instead of blocking the event loop. Until start() and
+// after stop(), records are written synchronously.
+class Logger {
+    public:
+        static const size_t kTextMax = 232;
+
+        static bool start(LogLevel minLevel);
+        static void stop();
+
+        static bool enabled(LogLevel level);
+        static void push(LogLevel level, const char* text, size_t len);
+        static unsigned long dropped();
+
+        // "debug", "info", "warn", "error", "off"
+        static bool parseLevel(const std::string& name, LogLevel& out);
+
+    private:
+        struct Record {
+            size_t volatile seq;
+            long            sec;
+            long            usec;
+            int             level;
+            size_t          len;
+            char            text[kTextMax];
+        };
+
+        static const size_t kSlots = 8192;
+
+        static Record               _ring[kSlots];
+        static size_t volatile      _tail;      // next slot to claim
+        static size_t               _head;      // next slot to drain
+        static unsigned long volatile _dropped;
+        static int volatile         _minLevel;
+        static bool volatile        _running;
+        static bool volatile        _sleeping;  // consumer waits on _wake
+        static pthread_mutex_t      _lock;
+        static pthread_cond_t       _wake;
+        static pthread_t            _thread;
+
+        Logger();
+
+        static void* entry(void* arg);
+        static bool drain();
+        static void wake();
+};
+
+// Builds one record on the stack and hands it over when the statement
+// ends: Log(LOG_INFO) << "[JOIN] " << nick << " joined " << room;
+// Text past Logger::kTextMax is cut. Disabled levels cost one compare.
+class Log {
+    private:
+        LogLevel    _level;
+        bool        _on;
+        size_t      _len;
+        char        _buf[Logger::kTextMax];
+
+        void append(const char* data, size_t len);
+
+        // Non-copyable
+        Log(const Log&);
+        Log& operator=(const Log&);
+
+    public:
+        explicit Log(LogLevel level);
+        ~Log();
+
+        Log& operator<<(const char* s);
+        Log& operator<<(const std::string& s);
+        Log& operator<<(const StrView& s);
+        Log& operator<<(long n);
+        Log& operator<<(unsigned long n);
+        Log& operator<<(int n);
+        Log& operator<<(unsigned int n);
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef MAILBOX_HPP
+#define MAILBOX_HPP
+
+#include <cstddef>
+
+// Lock-free multi-producer / single-consumer queue of intrusive nodes
+// (T must expose a `T* next` member). Producers push with a CAS on the
+// head; the consumer detaches the whole list at once and restores FIFO
+// order, so there is no ABA window and no lock on either side.
+template <typename T>
+class Mailbox {
+    private:
+        T* volatile _head;
+
+        // Non-copyable
+        Mailbox(const Mailbox&);
+        Mailbox& operator=(const Mailbox&);
+
+    public:
+        Mailbox() : _head(NULL) {}
+
+        ~Mailbox()
+        {
+            T* item = collect();
+            while (item)
+            {
+                T* next = item->next;
+                delete item;
+                item = next;
+            }
+        }
+
+        // Returns true if the box was empty, i.e. the consumer needs a wakeup
+        bool post(T* item)
+        {
+            T* old;
+            do
+            {
+                old = _head;
+                item->next = old;
+            }
+            while (__sync_val_compare_and_swap(&_head, old, item) != old);
+            return old == NULL;
+        }
+
+        // Detaches everything posted so far, oldest first
+        T* collect()
+        {
+            T* list;
+            do
+            {
+                list = _head;
+                if (!list)
+                    return NULL;
+            }
+            while (__sync_val_compare_and_swap(&_head, list, (T*)NULL) != list);
+
+            T* ordered = NULL;
+            while (list)
+            {
+                T* next = list->next;
+                list->next = ordered;
+                ordered = list;
+                list = next;
+            }
+            return ordered;
+        }
+};
+
+// Self-pipe used to wake a thread blocked in its event backend
+class Doorbell {
+    private:
+        int _fds[2];
+
+        // Non-copyable
+        Doorbell(const Doorbell&);
+        Doorbell& operator=(const Doorbell&);
+
+    public:
+        Doorbell();
+        ~Doorbell();
+
+        bool isValid() const;
+        int  fd() const;
+        void ring();
+        void drain();
+};
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Monotonic total. add() is one atomic increment, so I/O threads may bump
+// the same counter as the core thread.
+class Counter {
+    private:
+        unsigned long volatile  _value;
+
+    public:
+        Counter();
+        void add(unsigned long n = 1);
+        unsigned long value() const;
+};
+
+// Point-in-time value, set by the core thread (usually right before a
+// scrape, from state it already tracks)
+class Gauge {
+    private:
+        long volatile   _value;
+
+    public:
+        Gauge();
+        void set(long v);
+        long value() const;
+};
+
+// Bucketed distribution with fixed upper bounds, rendered cumulatively
+// like a Prometheus histogram. Core thread only.
+class Histogram {
+    private:
+        std::vector<double>         _bounds;
+        std::vector<unsigned long>  _counts;    // one per bound, plus +Inf
+        double                      _sum;
+        unsigned long               _count;
+
+    public:
+        Histogram(const double* bounds, size_t count);
+        void observe(double v);
+
+        size_t buckets() const;
+        double bound(size_t i) const;
+        // Observations <= bound(i), or all of them for i == buckets()
+        unsigned long cumulative(size_t i) const;
+        double sum() const;
+        unsigned long count() const;
+};
+
+// Log-linear histogram (HDR style) for durations in nanoseconds: each
+// power of two is split into kSub linear buckets, so a percentile is off
+// by at most 1/kSub of its value anywhere from 1 ns to hours. Recording
+// is a shift and an increment. Core thread only.
+class LatencyHistogram {
+    public:
+        static const unsigned       kSubBits = 3;
+        static const unsigned       kSub = 1 << kSubBits;
+        static const unsigned       kBuckets = (64 - kSubBits + 1) * kSub;
+
+    private:
+        unsigned long       _counts[kBuckets];
+        unsigned long       _count;
+        unsigned long long  _sum;
+        unsigned long long  _max;
+
+        static unsigned bucketOf(unsigned long long v);
+        static unsigned long long upperEdge(unsigned bucket);
+
+    public:
+        LatencyHistogram();
+        void record(unsigned long long ns);
+
+        unsigned long count() const;
+        unsigned long long sum() const;
+        unsigned long long max() const;
+        // Smallest bucket edge with at least q (0..1) of the samples at or
+        // below it, capped at the largest sample
+        unsigned long long percentile(double q) const;
+};
+
+// Owns every instrument and renders them in the Prometheus text format.
+// Instruments are registered once, before any thread uses them, and live
+// as long as the registry.
+class MetricsRegistry {
+    private:
+        enum Kind { COUNTER, GAUGE, HISTOGRAM };
+        struct Entry {
+            std::string     name;
+            std::string     help;
+            Kind            kind;
+            void*           metric;
+        };
+        std::vector<Entry>  _entries;
+
+        // Non-copyable
+        MetricsRegistry(const MetricsRegistry&);
+        MetricsRegistry& operator=(const MetricsRegistry&);
+
+    public:
+        MetricsRegistry();
+        ~MetricsRegistry();
+
+        Counter& counter(const std::string& name, const std::string& help);
+        Gauge& gauge(const std::string& name, const std::string& help);
+        Histogram& histogram(const std::string& name, const std::string& help,
+                             const double* bounds, size_t count);
+
+        void render(std::string& out) const;
+};
+
+// The server's instruments, registered in a process-wide registry the
+// first time serverMetrics() is called (by the IRCCore constructor,
+// before any I/O thread starts)
+struct ServerMetrics {
+    MetricsRegistry     registry;
+
+    // Traffic
+    Counter&    bytesIn;
+    Counter&    bytesOut;
+    Counter&    linesIn;
+    Counter&    linesOut;       // replies plus relayed lines
+    Counter&    relays;         // lines sent to a whole channel
+    Counter&    fanout;         // deliveries made by those relays
+
+    // Connections
+    Counter&    accepted;
+    Counter&    rejected;       // over the per-address limits
+    Gauge&      acceptRate;     // accepts during the last full second
+    Counter&    acceptOverflows;    // kernel listen queue overflows
+    Counter&    acceptBudgetHits;   // ticks that left connections queued
+    Counter&    tlsHandshakes;
+    Counter&    tlsOffloaded;   // handed to kernel TLS
+    Counter&    evictions;      // SendQ exceeded
+    Counter&    timeouts;       // registration, ping or idle
+    Histogram&  lag;            // PING round trips, seconds
+    Gauge&      sessions;
+    Gauge&      rooms;
+    Gauge&      trackedHosts;   // addresses in the admission table
+
+    // Queues (refreshed on scrape)
+    Gauge&      sendqBytes;
+    Gauge&      sendqPeak;
+    Gauge&      pausedSessions;
+    Gauge&      throttledSessions;
+
+    // Slab pools (refreshed on scrape)
+    Gauge&      sessionSlotsInUse;
+    Gauge&      sessionSlots;
+    Gauge&      sessionSlotsPeak;
+    Gauge&      roomSlotsInUse;
+    Gauge&      roomSlots;
+    Gauge&      roomSlotsPeak;
+
+    // Event loop
+    Counter&    wakeups;
+    Histogram&  eventsPerWakeup;
+
+    ServerMetrics();
+};
+
+ServerMetrics& serverMetrics();
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef OUTQUEUE_HPP
+#define OUTQUEUE_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "SharedBuffer.hpp"
+
+// Per-connection output: a FIFO of chunks plus the offset already sent
+// from the first one. Queuing a broadcast line costs one reference, small
+// private replies are packed into the tail chunk, and flush() hands many
+// chunks to the kernel in one gathered write. Sent chunks are popped from
+// the front, so a partial write never moves the remaining bytes.
+class OutQueue {
+    private:
+        std::deque<BufRef>  _chunks;
+        size_t              _headOffset;
+        size_t              _bytes;
+        bool                _tailPrivate;
+
+        // Non-copyable
+        OutQueue(const OutQueue&);
+        OutQueue& operator=(const OutQueue&);
+
+    public:
+        OutQueue();
+        ~OutQueue();
+
+        void push(const BufRef& chunk);
+        void push(const std::string& bytes);
+        void push(const char* data, size_t len);
+
+        bool empty() const;
+        size_t bytes() const;
+        size_t chunkCount() const;
+
+        // Drops `n` sent bytes, releasing every chunk fully consumed
+        void consume(size_t n);
+        // Sends as much as one writev-style call takes; bytes sent or -1
+        ssize_t flush(int fd);
+        // Fills up to `max` iovecs from the head of the queue without
+        // consuming; `keep` (if set) receives a reference to each chunk
+        // so the bytes outlive the queue during an asynchronous send
+        size_t gather(struct iovec* iov, size_t max,
+                      std::vector<BufRef>* keep = NULL) const;
+        // Moves all chunks of `from` to the tail of this queue
+        void splice(OutQueue& from);
+        void clear();
+};
+
+// Send queue depth snapshot, summed over the connections it covers
+struct SendQStats {
+    size_t          queuedBytes;    // unsent bytes right now
+    size_t          peakQueue;      // deepest single queue seen
+    size_t          paused;         // clients not being read (high watermark)
+    unsigned long   evicted;        // clients dropped for "SendQ exceeded"
+
+    SendQStats();
+    void add(const SendQStats& other);
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef POLLER_HPP
+#define POLLER_HPP
+
+#include <string>
+#include <vector>
+#include <poll.h>
+#ifdef __linux__
+# include <sys/epoll.h>
+#endif
+
+// Readiness / interest bits shared by every backend
+enum {
+    IO_READ  = 1,
+    IO_WRITE = 2,
+    IO_ERROR = 4
+};
+
+struct IOEvent {
+    int fd;
+    int flags;
+};
+
+// Event backend interface: the loop registers interest once per fd and only
+// touches it again when the write state of a session actually changes.
+class Poller {
+    private:
+        // Non-copyable
+        Poller(const Poller&);
+        Poller& operator=(const Poller&);
+
+    protected:
+        Poller();
+
+    public:
+        virtual ~Poller();
+
+        virtual bool watch(int fd, int interest) = 0;
+        virtual bool rewatch(int fd, int interest) = 0;
+        virtual void unwatch(int fd) = 0;
+        // Fills `out` with ready fds only; returns the count or -1 on error
+        virtual int wait(std::vector<IOEvent>& out, int timeoutMs) = 0;
+        virtual const char* name() const = 0;
+
+        // "poll", "epoll" or "auto" (best available); NULL if unsupported
+        static Poller* create(const std::string& kind);
+};
+
+// Portable fallback: pollfd array with an fd -> slot index so that
+// interest updates and removals are O(1) instead of a linear scan.
+class PollPoller : public Poller {
+    private:
+        std::vector<struct pollfd>  _fds;
+        std::vector<int>            _slotOf;
+
+        int slotOf(int fd) const;
+
+    public:
+        PollPoller();
+        ~PollPoller();
+
+        bool watch(int fd, int interest);
+        bool rewatch(int fd, int interest);
+        void unwatch(int fd);
+        int wait(std::vector<IOEvent>& out, int timeoutMs);
+        const char* name() const;
+};
+
+#ifdef __linux__
+// Level-triggered epoll: the kernel keeps the interest set, each wakeup
+// only reports the fds that are actually ready.
+class EpollPoller : public Poller {
+    private:
+        int                         _epfd;
+        std::vector<struct epoll_event> _ready;
+        size_t                      _watched;
+
+    public:
+        EpollPoller();
+        ~EpollPoller();
+
+        bool isValid() const;
+        bool watch(int fd, int interest);
+        bool rewatch(int fd, int interest);
+        void unwatch(int fd);
+        int wait(std::vector<IOEvent>& out, int timeoutMs);
+        const char* name() const;
+};
+#endif
+
+#endif
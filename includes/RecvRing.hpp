@@ -0,0 +1,51 @@
+#ifndef RECVRING_HPP
+#define RECVRING_HPP
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+#include "StrView.hpp"
+
+// Per-session receive ring. recv() lands directly in free space, complete
+// lines are framed in place and returned as views, and an unterminated
+// tail simply stays where it is until more bytes arrive. Only a line that
+// straddles the wrap point is copied, into a reused scratch string.
+// Storage is allocated on first use and grows by doubling up to kMax.
+class RecvRing {
+    private:
+        char*       _buf;
+        size_t      _cap;       // power of two
+        size_t      _head;      // absolute read position
+        size_t      _tail;      // absolute write position
+        size_t      _scanned;   // bytes from _head known to hold no '\n'
+        std::string _wrapped;
+
+        // Non-copyable
+        RecvRing(const RecvRing&);
+        RecvRing& operator=(const RecvRing&);
+
+        bool reserve(size_t extra);
+        char& at(size_t pos);
+
+    public:
+        static const size_t kInitial = 1024;
+        static const size_t kMax = 8192;
+        static const size_t kReadMin = 512;     // smallest recv() offered
+
+        RecvRing();
+        ~RecvRing();
+
+        size_t pending() const;
+        // At kMax with no room for another read
+        bool full() const;
+
+        // recv()s straight into the free space; same return as recv()
+        ssize_t readFrom(int fd);
+        // Copies bytes received elsewhere (I/O threads); false if full
+        bool append(const char* data, size_t len);
+        // Next complete line without "\r\n" and with control bytes removed.
+        // The view stays valid until the ring is written to again.
+        bool nextLine(StrView& line);
+};
+
+#endif
@@ -3,17 +3,40 @@
 
 #include <string>
 #include <vector>
+#include "HashMap.hpp"
+#include "SlabPool.hpp"
 
 class Session;
 
+// Per-member flag bits
+enum {
+    MEMBER_JOINED   = 1,    // in _users
+    MEMBER_OP       = 2,
+    MEMBER_VOICE    = 4,
+    MEMBER_INVITED  = 8
+};
+
 class Room {
     private:
         std::string             _label;
         std::string             _subject;
         std::string             _passphrase;
+        // One entry per joined or invited session; slot is the position
+        // in _users, which stays dense for cache-friendly relays
+        struct Member {
+            unsigned int    flags;
+            size_t          slot;
+        };
+        typedef HashMap<Session*, Member, PointerTraits<Session> > MemberTable;
+        struct GuestCollector;
+
         std::vector<Session*>   _users;
-        std::vector<Session*>   _admins;
-        std::vector<Session*>   _guestList;
+        MemberTable             _members;
+        // NAMES body: " @op nick ..." (every token carries its leading
+        // space). JOIN appends to it; any other change only marks it
+        // stale, and the next reader rebuilds it in one pass.
+        mutable std::string     _names;
+        mutable bool            _namesStale;
         bool                    _restricted;
         bool                    _lockedSubject;
         int                     _maxUsers;
@@ -22,7 +45,19 @@ class Room {
         Room(const Room&);
         Room& operator=(const Room&);
 
+        bool hasFlag(Session* s, unsigned int flag) const;
+        void setFlag(Session* s, unsigned int flag);
+        void clearFlag(Session* s, unsigned int flag);
+
+        std::string nameToken(Session* s) const;
+        static void countRelay(size_t recipients);
+
     public:
+        // Instances are carved from a slab pool instead of the heap
+        static void* operator new(size_t size);
+        static void operator delete(void* p);
+        static SlabPool& pool();
+
         Room(const std::string& label);
         ~Room();
 
@@ -33,7 +68,10 @@ class Room {
         bool isRestricted() const;
         bool hasLockedSubject() const;
         int getMaxUsers() const;
-        std::vector<Session*>& getUserList();
+        const std::vector<Session*>& getUserList() const;
+        unsigned int memberFlags(Session* s) const;
+        // Space-separated NAMES tokens, ready to be split into 353 replies
+        const std::string& getNames() const;
 
         // Mutators
         void changeSubject(const std::string& subject);
@@ -46,8 +84,10 @@ class Room {
         void insertUser(Session* s);
         void eraseUser(Session* s);
         bool hasUser(Session* s) const;
+        // A member changed nickname
+        void renameUser(Session* s);
 
-        // Admin management
+        // Admin management (members only)
         void promoteAdmin(Session* s);
         void demoteAdmin(Session* s);
         bool isAdmin(Session* s) const;
@@ -2,29 +2,62 @@
 #define SESSION_HPP
 
 #include <string>
+#include <vector>
+#include "OutQueue.hpp"
+#include "RecvRing.hpp"
+#include "SlabPool.hpp"
+#include "TimerWheel.hpp"
+
+class Room;
+class TlsStream;
 
 class Session {
     private:
         int         _sockFd;
         std::string _nick;
         std::string _user;
-        std::string _recvBuf;
-        std::string _outBuf;
+        RecvRing    _recvRing;
+        OutQueue    _outQueue;
         bool        _passOk;
         bool        _welcomed;
+        bool        _oper;          // authenticated with OPER
+        int         _interest;      // IO_* flags registered with the backend
+        bool        _readPaused;    // send queue above the high watermark
+        int         _worker;
+        unsigned long _connId;
+        bool        _dirty;         // already listed in _pendingWrites
+        long        _floodClock;    // ms at which the token bucket is empty
+        bool        _throttled;     // input deferred, listed in _throttled
+        Timer       _timer;         // next registration/keepalive deadline
+        long        _lastActive;    // ms of the last command besides PING/PONG
+        long        _nextPing;      // ms at which the server PINGs next
+        long        _pingSent;      // ms of the unanswered PING, -1: none
+        long        _lag;           // last PING round trip in ms, -1: none yet
+        unsigned int _peerAddr;     // IPv4, host order
+        TlsStream*  _tls;           // NULL: plaintext, or kTLS after the handshake
+        std::vector<int>* _pendingWrites;
+        std::vector<Room*> _rooms;      // rooms joined, in join order
+        std::vector<Room*> _invites;    // rooms holding a pending INVITE
 
         // Non-copyable
         Session(const Session&);
         Session& operator=(const Session&);
 
+        void markDirty();
+
     public:
-        Session(int fd);
+        // Instances are carved from a slab pool instead of the heap
+        static void* operator new(size_t size);
+        static void operator delete(void* p);
+        static SlabPool& pool();
+
+        // pendingWrites collects the fds of sessions that gained output
+        Session(int fd, std::vector<int>* pendingWrites);
         ~Session();
 
         int         getSocket() const;
         std::string getNick() const;
         std::string getUser() const;
-        std::string getRecvBuf() const;
         bool        hasValidPass() const;
         bool        isWelcomed() const;
 
@@ -32,14 +65,63 @@ class Session {
         void setUser(const std::string& user);
         void markPassOk(bool ok);
         void markWelcomed(bool w);
+        bool isOper() const;
+        void setOper(bool oper);
 
-        void feedRecvBuf(const std::string& chunk);
-        void resetRecvBuf();
+        RecvRing& getRecvRing();
 
         void pushToOutBuf(const std::string& data);
-        const std::string& getOutBuf() const;
-        void drainOutBuf(size_t bytes);
+        void pushToOutBuf(const BufRef& line);
+        OutQueue& getOutQueue();
         bool hasQueuedData() const;
+        // Set from the first push until the end-of-tick write pass
+        bool isDirty() const;
+        void clearDirty();
+
+        // Flood control: the bucket is modelled as the time at which it
+        // runs dry, so refilling costs nothing until the next command
+        long getFloodClock() const;
+        void setFloodClock(long ms);
+        bool isThrottled() const;
+        void setThrottled(bool throttled);
+
+        // Keepalive: the timer's owner is the session, and destroying the
+        // session disarms it
+        Timer& getTimer();
+        long getLastActive() const;
+        void setLastActive(long ms);
+        long getNextPing() const;
+        void setNextPing(long ms);
+        long getPingSent() const;
+        void setPingSent(long ms);
+        long getLag() const;
+        void setLag(long ms);
+
+        unsigned int getPeerAddr() const;
+        void setPeerAddr(unsigned int addr);
+
+        // Owned; deleted with the session
+        TlsStream* getTls() const;
+        void setTls(TlsStream* tls);
+
+        // IO_* flags the event backend currently watches this fd for
+        int  getInterest() const;
+        void setInterest(int flags);
+        bool isReadPaused() const;
+        void setReadPaused(bool paused);
+
+        // I/O thread that owns the socket (-1 when served by the core loop)
+        int  getWorker() const;
+        unsigned long getConnId() const;
+        void attachWorker(int worker, unsigned long connId);
+
+        // Reverse membership index, kept in sync by Room itself
+        const std::vector<Room*>& getRooms() const;
+        const std::vector<Room*>& getInvites() const;
+        void linkRoom(Room* room);
+        void unlinkRoom(Room* room);
+        void linkInvite(Room* room);
+        void unlinkInvite(Room* room);
 };
 
 #endif
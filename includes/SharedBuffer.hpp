@@ -0,0 +1,57 @@
+#ifndef SHAREDBUFFER_HPP
+#define SHAREDBUFFER_HPP
+
+#include <cstddef>
+#include <string>
+
+// Reference-counted byte block. A broadcast line is serialized into one
+// of these once and every recipient queue holds a reference. Header and
+// payload share a single allocation; the count is atomic because I/O
+// threads may drop the last reference. Bytes can only be appended while
+// a single owner holds the block, so shared content never changes.
+class SharedBuffer {
+    private:
+        int volatile    _refs;
+        size_t          _size;
+        size_t          _capacity;
+
+        SharedBuffer(size_t size, size_t capacity);
+        ~SharedBuffer();
+
+        // Non-copyable
+        SharedBuffer(const SharedBuffer&);
+        SharedBuffer& operator=(const SharedBuffer&);
+
+    public:
+        static SharedBuffer* create(const char* data, size_t len,
+                                    size_t capacity = 0);
+
+        void retain();
+        void release();
+
+        const char* data() const;
+        size_t size() const;
+        // Appends in place if unshared and large enough; false otherwise
+        bool tryAppend(const char* data, size_t len);
+};
+
+// Owning handle to a SharedBuffer
+class BufRef {
+    private:
+        SharedBuffer* _buf;
+
+    public:
+        BufRef();
+        explicit BufRef(const std::string& bytes);
+        BufRef(const char* data, size_t len, size_t capacity = 0);
+        BufRef(const BufRef& other);
+        BufRef& operator=(const BufRef& other);
+        ~BufRef();
+
+        bool isNull() const;
+        const char* data() const;
+        size_t size() const;
+        bool tryAppend(const char* data, size_t len);
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef SLABPOOL_HPP
+#define SLABPOOL_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Occupancy snapshot of a SlabPool
+struct PoolStats {
+    size_t          objectSize;
+    size_t          slabs;
+    size_t          capacity;       // slots carved so far
+    size_t          inUse;
+    size_t          peak;
+    unsigned long   allocations;    // lifetime, including reuses
+};
+
+// Fixed-size object slabs with an intrusive LIFO freelist. Slots are
+// recycled forever and slabs are never handed back to the heap, so
+// connection and channel churn stops fragmenting it. Core thread only.
+class SlabPool {
+    private:
+        struct FreeSlot {
+            FreeSlot* next;
+        };
+
+        size_t              _objectSize;
+        size_t              _perSlab;
+        std::vector<char*>  _slabs;
+        FreeSlot*           _free;
+        size_t              _capacity;
+        size_t              _inUse;
+        size_t              _peak;
+        unsigned long       _allocations;
+
+        // Non-copyable
+        SlabPool(const SlabPool&);
+        SlabPool& operator=(const SlabPool&);
+
+        void addSlab(size_t count);
+
+    public:
+        SlabPool(size_t objectSize, size_t perSlab);
+        ~SlabPool();
+
+        void* allocate();
+        void release(void* p);
+        // Carves slots up front until at least `count` exist
+        void reserve(size_t count);
+
+        PoolStats stats() const;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef STRVIEW_HPP
+#define STRVIEW_HPP
+
+#include <cstddef>
+#include <string>
+
+// Non-owning view over bytes held elsewhere (receive ring, parsed line).
+// Valid only as long as the underlying storage is left untouched.
+class StrView {
+    private:
+        const char* _data;
+        size_t      _len;
+
+    public:
+        static const size_t npos = static_cast<size_t>(-1);
+
+        StrView() : _data(""), _len(0) {}
+        StrView(const char* data, size_t len) : _data(data), _len(len) {}
+        StrView(const char* cstr);
+        StrView(const std::string& s) : _data(s.data()), _len(s.size()) {}
+
+        const char* data() const { return _data; }
+        size_t size() const { return _len; }
+        bool empty() const { return _len == 0; }
+        char operator[](size_t i) const { return _data[i]; }
+
+        std::string str() const { return std::string(_data, _len); }
+        StrView substr(size_t pos, size_t n = npos) const;
+        size_t find(char c, size_t pos = 0) const;
+
+        bool operator==(const StrView& other) const;
+        bool operator!=(const StrView& other) const;
+};
+
+#endif
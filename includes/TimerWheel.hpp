@@ -0,0 +1,62 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include <cstddef>
+
+// Intrusive timer node, embedded in whatever owns the deadline. Unlinking
+// needs only the node, so an owner can be destroyed with its timer armed.
+struct Timer {
+    Timer*          prev;
+    Timer*          next;
+    unsigned long   expires;    // wheel tick
+    void*           owner;
+
+    Timer();
+    ~Timer();
+    bool pending() const;
+    void cancel();
+};
+
+// Hierarchical timer wheel: kLevels wheels of kSlots lists, each level
+// kSlots times coarser than the one below. Scheduling and cancelling are
+// a list link; a timer moves down a level at most kLevels - 1 times
+// before it expires, and nothing scans timers that are not due. Deadlines
+// round up to the next tick and are capped at the range of the top
+// level. Core thread only.
+class TimerWheel {
+    public:
+        static const unsigned   kBits = 6;
+        static const unsigned   kSlots = 1 << kBits;
+        static const unsigned   kLevels = 4;
+
+    private:
+        Timer               _slots[kLevels][kSlots];    // list heads
+        unsigned long long  _occupied[kLevels];         // may be stale: a
+                                                        // cancel leaves it set
+        Timer               _expired;
+        long                _originMs;
+        long                _tickMs;
+        unsigned long       _now;                       // last tick run
+
+        // Non-copyable
+        TimerWheel(const TimerWheel&);
+        TimerWheel& operator=(const TimerWheel&);
+
+        void place(Timer& t);
+        void cascade(unsigned level);
+        unsigned long tickAt(long ms) const;
+
+    public:
+        TimerWheel(long nowMs, long tickMs);
+
+        // Arms t to fire at dueMs, moving it if it was already armed
+        void schedule(Timer& t, long dueMs);
+        // Runs the wheel up to nowMs; due timers become poppable
+        void advance(long nowMs);
+        // Next due timer, unlinked, or NULL
+        Timer* popExpired();
+        // Milliseconds until the wheel needs to advance again, -1 if never
+        long nextTimeout(long nowMs) const;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef TLS_HPP
+#define TLS_HPP
+
+#include <string>
+#include <sys/types.h>
+
+// OpenSSL types, kept out of every header (builds without OpenSSL, made
+// with TLS=0, compile this interface and refuse --tls-port)
+struct ssl_st;
+struct ssl_ctx_st;
+class OutQueue;
+class RecvRing;
+
+// Server certificate, key and protocol settings, loaded once at startup
+class TlsContext {
+    private:
+        ssl_ctx_st*     _ctx;
+
+        // Non-copyable
+        TlsContext(const TlsContext&);
+        TlsContext& operator=(const TlsContext&);
+
+    public:
+        TlsContext();
+        ~TlsContext();
+
+        // Whether this build has OpenSSL at all
+        static bool available();
+        bool load(const std::string& certFile, const std::string& keyFile,
+                  std::string& error);
+        ssl_ctx_st* handle() const;
+};
+
+// One connection's TLS state. Once the handshake is done either the kernel
+// has taken over the record layer in both directions (kTLS), and the
+// stream can be dropped so plain recv/send carry on, or every read and
+// write goes through here.
+class TlsStream {
+    private:
+        ssl_st*     _ssl;
+        bool        _established;
+        bool        _wantWrite;     // last call stopped on a full socket
+
+        // Non-copyable
+        TlsStream(const TlsStream&);
+        TlsStream& operator=(const TlsStream&);
+
+    public:
+        enum Status { TLS_DONE, TLS_AGAIN, TLS_FAILED };
+
+        TlsStream(const TlsContext& ctx, int fd);
+        ~TlsStream();
+
+        bool valid() const;
+        Status handshake();
+        bool established() const;
+        bool wantsWrite() const;
+        // The kernel encrypts and decrypts, and nothing is buffered here
+        bool offloaded() const;
+        // Decrypts into the ring until the socket runs dry: bytes added,
+        // 0 when only part of a record came in, -1 on close, error, or a
+        // full ring (as RecvRing::readFrom)
+        ssize_t read(RecvRing& ring);
+        // Decrypted bytes a full ring left behind; poll() cannot see them
+        bool buffered() const;
+        // Encrypts from the head of the queue until the socket is full:
+        // bytes consumed, 0 if none fit, -1 on error
+        ssize_t write(OutQueue& out);
+        // Best-effort close_notify, before the socket is closed
+        void close();
+        // Protocol and cipher, e.g. "TLSv1.3 TLS_AES_256_GCM_SHA384"
+        std::string describe() const;
+};
+
+#endif
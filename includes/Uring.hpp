@@ -0,0 +1,95 @@
+#ifndef URING_HPP
+#define URING_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#ifdef __linux__
+# include <linux/io_uring.h>
+#endif
+
+struct UringCompletion {
+    uint64_t        tag;        // user_data of the request
+    int             res;        // result or -errno
+    unsigned int    flags;      // IORING_CQE_F_*
+};
+
+// Completion-based backend on io_uring (Linux 5.19+), driven through the
+// raw syscalls; there is no liburing dependency. Requests are only queued
+// by the methods below and reach the kernel together in submitAndWait(),
+// so one syscall per loop tick both submits and reaps. Receives use a
+// ring of provided buffers: the kernel picks one when data arrives, so an
+// idle connection holds no buffer, and it goes back through recycle().
+class Uring {
+    private:
+        int             _fd;
+        void*           _sqMap;
+        size_t          _sqMapLen;
+        void*           _cqMap;
+        size_t          _cqMapLen;
+        void*           _sqeMap;
+        size_t          _sqeMapLen;
+
+        // Submission ring
+        unsigned*       _sqHead;
+        unsigned*       _sqTail;
+        unsigned        _sqMask;
+        unsigned        _sqEntries;
+        unsigned*       _sqArray;
+        unsigned        _sqLocalTail;   // queued but not yet published
+        unsigned        _toSubmit;
+
+        // Completion ring
+        unsigned*       _cqHead;
+        unsigned*       _cqTail;
+        unsigned        _cqMask;
+        void*           _cqes;
+
+        // Provided receive buffers (group 0)
+        void*           _bufRing;
+        size_t          _bufRingLen;
+        char*           _bufData;
+        unsigned        _bufCount;
+        unsigned        _bufSize;
+        unsigned short  _bufTail;
+
+        // Non-copyable
+        Uring(const Uring&);
+        Uring& operator=(const Uring&);
+
+        bool setupRings(unsigned entries);
+        bool setupBuffers(unsigned count, unsigned size);
+        void* nextSqe();
+        void publish();
+        void provide(unsigned short bid);
+
+    public:
+        Uring();
+        ~Uring();
+
+        // entries: submission slots; count x size bytes of receive buffers
+        // (count must be a power of two). False if the kernel lacks any of
+        // the features used here.
+        bool init(unsigned entries, unsigned bufCount, unsigned bufSize);
+
+        // Queue requests; false only when the ring is unusable
+        bool acceptMultishot(int listenFd, uint64_t tag);
+        bool recv(int fd, uint64_t tag);
+        bool sendmsg(int fd, const struct msghdr* msg, uint64_t tag);
+        // One-shot readiness, for sockets served synchronously
+        bool pollIn(int fd, uint64_t tag);
+        bool cancel(uint64_t target, uint64_t tag);
+
+        // Submits everything queued and waits for at least one completion
+        // (timeoutMs < 0: no limit). Returns 0 or -errno (-ETIME on timeout).
+        int submitAndWait(int timeoutMs);
+        // Pops the next completion; false when the queue is empty
+        bool next(UringCompletion& out);
+
+        // Receive buffer chosen by a recv completion, and its return
+        const char* buffer(const UringCompletion& c) const;
+        void recycle(const UringCompletion& c);
+};
+
+#endif
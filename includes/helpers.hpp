@@ -2,8 +2,22 @@
 #define HELPERS_HPP
 
 #include <string>
+#include <cstddef>
 
 bool enable_nonblock(int fd);
 void fatal(const std::string& msg);
+// Milliseconds from an arbitrary fixed point; never goes backwards
+long monotonicMs();
+// Same clock in nanoseconds, for timing short sections
+unsigned long long monotonicNs();
+
+// RFC 1459 casemapping: A-Z plus []\~ fold to a-z plus {}|^
+char ircFold(char c);
+
+// HashMap traits comparing nicknames under RFC 1459 casemapping
+struct NickTraits {
+    static size_t hash(const std::string& nick);
+    static bool equal(const std::string& a, const std::string& b);
+};
 
 #endif
@@ -0,0 +1,405 @@
+#include "LoadGen.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+// Marker in every PRIVMSG body, followed by the send time in ns
+static const char kStamp[] = "lg:";
+
+static long long nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+static double seconds(long long ns)
+{
+	return ns / 1e9;
+}
+
+LoadOptions::LoadOptions()
+	: host("127.0.0.1"), port(0), io("auto"), clients(1000), channelSize(10),
+	rate(1000), duration(10), connectBatch(256)
+{
+}
+
+LoadGen::LoadGen(const LoadOptions& opt, Scenario scenario)
+	: _opt(opt), _scenario(scenario), _poller(NULL), _started(0), _pending(0),
+	_ready(0), _dead(0), _sent(0), _expected(0), _delivered(0)
+{
+}
+
+LoadGen::~LoadGen()
+{
+	for (size_t i = 0; i < _clients.size(); ++i)
+	{
+		if (_clients[i].fd >= 0)
+			close(_clients[i].fd);
+	}
+	delete _poller;
+}
+
+const char* LoadGen::name(Scenario s)
+{
+	switch (s)
+	{
+		case BIG_CHANNEL: return "big";
+		case SMALL_CHANNELS: return "small";
+		case DIRECT: return "dm";
+	}
+	return "?";
+}
+
+// Nicks, targets and expected fan-out for every client of the scenario
+void LoadGen::plan()
+{
+	size_t n = _opt.clients;
+	size_t size = _opt.channelSize ? _opt.channelSize : 1;
+	int tag = static_cast<int>(getpid() % 10000);
+
+	_clients.resize(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		Client& c = _clients[i];
+		std::ostringstream nick;
+		nick << "lg" << name(_scenario)[0] << tag << "_" << i;
+		c.fd = -1;
+		c.state = CONNECTING;
+		c.nick = nick.str();
+		c.wantWrite = false;
+	}
+	for (size_t i = 0; i < n; ++i)
+	{
+		Client& c = _clients[i];
+		std::ostringstream target;
+		if (_scenario == BIG_CHANNEL)
+		{
+			target << "#lg" << tag;
+			c.fanout = n - 1;
+		}
+		else if (_scenario == SMALL_CHANNELS)
+		{
+			size_t first = i / size * size;
+			target << "#lg" << tag << "_" << i / size;
+			c.fanout = std::min(size, n - first) - 1;
+		}
+		else
+		{
+			target << _clients[(i + 1) % n].nick;
+			c.fanout = n > 1 ? 1 : 0;
+		}
+		c.target = target.str();
+	}
+}
+
+bool LoadGen::startConnect(size_t idx)
+{
+	Client& c = _clients[idx];
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(_opt.port);
+	if (inet_pton(AF_INET, _opt.host.c_str(), &addr.sin_addr) != 1)
+		return false;
+
+	c.fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (c.fd < 0)
+	{
+		std::fprintf(stderr, "socket: %s\n", std::strerror(errno));
+		return false;
+	}
+	fcntl(c.fd, F_SETFL, O_NONBLOCK);
+	int one = 1;
+	setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	if (connect(c.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+		&& errno != EINPROGRESS)
+	{
+		std::fprintf(stderr, "connect: %s\n", std::strerror(errno));
+		close(c.fd);
+		c.fd = -1;
+		return false;
+	}
+	if (static_cast<size_t>(c.fd) >= _slotOf.size())
+		_slotOf.resize(c.fd + 1, -1);
+	_slotOf[c.fd] = static_cast<int>(idx);
+	_poller->watch(c.fd, IO_READ | IO_WRITE);
+	c.wantWrite = true;
+	++_pending;
+	return true;
+}
+
+void LoadGen::pump(int timeoutMs)
+{
+	int ready = _poller->wait(_events, timeoutMs);
+	for (int i = 0; i < ready; ++i)
+	{
+		int fd = _events[i].fd;
+		if (fd < 0 || static_cast<size_t>(fd) >= _slotOf.size() || _slotOf[fd] < 0)
+			continue;
+		Client& c = _clients[_slotOf[fd]];
+		if (_events[i].flags & IO_ERROR)
+		{
+			kill(c);
+			continue;
+		}
+		if (_events[i].flags & IO_WRITE)
+			onWritable(c);
+		if (c.fd >= 0 && (_events[i].flags & IO_READ))
+			onReadable(c);
+	}
+}
+
+void LoadGen::onWritable(Client& c)
+{
+	if (c.state == CONNECTING)
+	{
+		int err = 0;
+		socklen_t len = sizeof(err);
+		getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+		--_pending;
+		if (err)
+		{
+			std::fprintf(stderr, "connect: %s\n", std::strerror(err));
+			kill(c);
+			return;
+		}
+		c.state = REGISTERING;
+		queue(c, "PASS " + _opt.password + "\r\nNICK " + c.nick + "\r\nUSER "
+			+ c.nick + " 0 * :loadgen\r\n");
+		return;
+	}
+	flush(c);
+}
+
+void LoadGen::onReadable(Client& c)
+{
+	char buf[16384];
+	ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+	if (n <= 0)
+	{
+		if (n == 0 || errno != EINTR)
+			kill(c);
+		return;
+	}
+	c.in.append(buf, n);
+
+	size_t start = 0;
+	size_t end;
+	while (c.fd >= 0 && (end = c.in.find("\r\n", start)) != std::string::npos)
+	{
+		onLine(c, c.in.substr(start, end - start));
+		start = end + 2;
+	}
+	c.in.erase(0, start);
+}
+
+void LoadGen::onLine(Client& c, const std::string& line)
+{
+	if (line.compare(0, 5, "PING ") == 0)
+	{
+		queue(c, "PONG " + line.substr(5) + "\r\n");
+		return;
+	}
+
+	size_t stamp = line.find(" PRIVMSG ");
+	if (stamp != std::string::npos
+		&& (stamp = line.find(kStamp, stamp)) != std::string::npos)
+	{
+		long long sentAt = std::atoll(line.c_str() + stamp + sizeof(kStamp) - 1);
+		long long us = (nowNs() - sentAt) / 1000;
+		_latencyUs.push_back(us > 0 ? static_cast<unsigned>(us) : 0);
+		++_delivered;
+		return;
+	}
+
+	if (c.state == REGISTERING && line.find(" 001 ") != std::string::npos)
+	{
+		if (_scenario == DIRECT)
+		{
+			c.state = READY;
+			++_ready;
+		}
+		else
+		{
+			c.state = JOINING;
+			queue(c, "JOIN " + c.target + "\r\n");
+		}
+	}
+	else if (c.state == JOINING && line.find(" 366 ") != std::string::npos)
+	{
+		c.state = READY;
+		++_ready;
+	}
+	else if (line.compare(0, 6, "ERROR ") == 0
+		|| (c.state == REGISTERING && line.find(" 433 ") != std::string::npos))
+	{
+		std::fprintf(stderr, "%s: %s\n", c.nick.c_str(), line.c_str());
+		kill(c);
+	}
+}
+
+void LoadGen::queue(Client& c, const std::string& data)
+{
+	if (c.fd < 0)
+		return;
+	c.out += data;
+	flush(c);
+}
+
+void LoadGen::flush(Client& c)
+{
+	while (!c.out.empty())
+	{
+		ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+		if (n <= 0)
+			break;
+		c.out.erase(0, n);
+	}
+	bool want = !c.out.empty();
+	if (want != c.wantWrite)
+	{
+		_poller->rewatch(c.fd, IO_READ | (want ? IO_WRITE : 0));
+		c.wantWrite = want;
+	}
+}
+
+void LoadGen::kill(Client& c)
+{
+	if (c.fd < 0)
+		return;
+	if (c.state == CONNECTING)
+		--_pending;
+	if (c.state == READY)
+		--_ready;
+	_poller->unwatch(c.fd);
+	_slotOf[c.fd] = -1;
+	close(c.fd);
+	c.fd = -1;
+	c.state = DEAD;
+	++_dead;
+}
+
+// Stamped with the time the schedule wanted it sent, not when it went
+// out: time spent behind schedule counts as latency
+void LoadGen::sendOne(size_t idx, long long scheduledNs)
+{
+	Client& c = _clients[idx];
+	if (c.state != READY)
+		return;
+	std::ostringstream msg;
+	msg << "PRIVMSG " << c.target << " :" << kStamp << scheduledNs << "\r\n";
+	queue(c, msg.str());
+	++_sent;
+	_expected += c.fanout;
+}
+
+bool LoadGen::run()
+{
+	_poller = Poller::create(_opt.io);
+	if (!_poller)
+	{
+		std::fprintf(stderr, "event backend '%s' is not available\n", _opt.io.c_str());
+		return false;
+	}
+	plan();
+	size_t n = _clients.size();
+
+	if (_scenario == BIG_CHANNEL)
+		std::printf("scenario big: %lu clients in one channel\n",
+			static_cast<unsigned long>(n));
+	else if (_scenario == SMALL_CHANNELS)
+		std::printf("scenario small: %lu clients in channels of %lu\n",
+			static_cast<unsigned long>(n),
+			static_cast<unsigned long>(_opt.channelSize));
+	else
+		std::printf("scenario dm: %lu clients, each messaging the next\n",
+			static_cast<unsigned long>(n));
+
+	// Connect and register, with at most connectBatch handshakes pending
+	long long t0 = nowNs();
+	long long deadline = t0 + 60LL * 1000000000LL;
+	while (_ready + _dead < n && nowNs() < deadline)
+	{
+		while (_started < n && _pending < _opt.connectBatch)
+		{
+			if (!startConnect(_started++))
+				++_dead;
+		}
+		pump(10);
+	}
+	double setup = seconds(nowNs() - t0);
+	std::printf("  connect   %lu ready in %.2f s (%.0f clients/s), %lu failed\n",
+		static_cast<unsigned long>(_ready), setup, setup > 0 ? _ready / setup : 0,
+		static_cast<unsigned long>(n - _ready));
+	if (_ready == 0)
+		return false;
+
+	// Let the JOIN broadcasts settle so they do not count against the load
+	long long settle = nowNs() + 200LL * 1000000;
+	while (nowNs() < settle)
+		pump(10);
+	_latencyUs.reserve(static_cast<size_t>(_opt.rate * _opt.duration * 4));
+
+	// Load: message k is due at start + k / rate and carries that time, so
+	// neither a slow server nor a generator falling behind hides any
+	// waiting from the latencies (no coordinated omission)
+	long long start = nowNs();
+	long long stop = start + static_cast<long long>(_opt.duration * 1e9);
+	size_t next = 0;
+	long long now;
+	while ((now = nowNs()) < stop)
+	{
+		unsigned long due = static_cast<unsigned long>(seconds(now - start) * _opt.rate);
+		while (_sent < due && _ready > 0)
+		{
+			sendOne(next, start + static_cast<long long>(_sent * 1e9 / _opt.rate));
+			next = (next + 1) % n;
+		}
+		pump(1);
+	}
+	double elapsed = seconds(nowNs() - start);
+
+	// Wait for deliveries still in flight
+	long long drainEnd = nowNs() + 5LL * 1000000000LL;
+	while (_delivered < _expected && nowNs() < drainEnd)
+		pump(10);
+
+	std::printf("  sent      %lu msgs in %.2f s (%.0f msgs/s)\n", _sent, elapsed,
+		elapsed > 0 ? _sent / elapsed : 0);
+	std::printf("  delivered %lu of %lu (%.0f msgs/s), %lu clients disconnected\n",
+		_delivered, _expected, elapsed > 0 ? _delivered / elapsed : 0,
+		static_cast<unsigned long>(_dead));
+	printLatency();
+	return true;
+}
+
+void LoadGen::printLatency() const
+{
+	if (_latencyUs.empty())
+	{
+		std::printf("  latency   no samples\n");
+		return;
+	}
+	std::vector<unsigned> v(_latencyUs);
+	std::sort(v.begin(), v.end());
+	static const double kPct[] = { 0.50, 0.90, 0.99, 0.999 };
+	static const char* kLabel[] = { "p50", "p90", "p99", "p99.9" };
+
+	std::printf("  latency  ");
+	for (size_t i = 0; i < 4; ++i)
+		std::printf(" %s %.3f ms", kLabel[i],
+			v[static_cast<size_t>(kPct[i] * (v.size() - 1))] / 1000.0);
+	std::printf("  max %.3f ms\n", v.back() / 1000.0);
+}
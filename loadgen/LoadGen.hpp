@@ -0,0 +1,86 @@
+#ifndef LOADGEN_HPP
+#define LOADGEN_HPP
+
+#include <string>
+#include <vector>
+#include "Poller.hpp"
+
+struct LoadOptions {
+    std::string     host;
+    int             port;
+    std::string     password;
+    std::string     io;             // client-side event backend
+    size_t          clients;
+    size_t          channelSize;    // "small" scenario
+    double          rate;           // PRIVMSG per second, all clients together
+    double          duration;       // seconds of load
+    size_t          connectBatch;   // connects in flight at once
+
+    LoadOptions();
+};
+
+// Drives one scenario: connect and register every client, join the
+// channels, then send PRIVMSG at a fixed total rate and time each
+// delivery. Every message carries its send time, so latency is measured
+// from the sender's send() to the receiver's recv().
+class LoadGen {
+    public:
+        enum Scenario { BIG_CHANNEL, SMALL_CHANNELS, DIRECT };
+
+    private:
+        enum State { CONNECTING, REGISTERING, JOINING, READY, DEAD };
+
+        struct Client {
+            int             fd;
+            State           state;
+            std::string     nick;
+            std::string     target;     // channel or peer nick
+            size_t          fanout;     // deliveries per message sent
+            std::string     in;
+            std::string     out;
+            bool            wantWrite;
+        };
+
+        const LoadOptions&      _opt;
+        Scenario                _scenario;
+        Poller*                 _poller;
+        std::vector<Client>     _clients;
+        std::vector<int>        _slotOf;        // fd -> index in _clients
+        std::vector<IOEvent>    _events;
+        size_t                  _started;       // connects issued
+        size_t                  _pending;       // connects not yet answered
+        size_t                  _ready;
+        size_t                  _dead;
+
+        unsigned long           _sent;
+        unsigned long           _expected;
+        unsigned long           _delivered;
+        std::vector<unsigned>   _latencyUs;
+
+        // Non-copyable
+        LoadGen(const LoadGen&);
+        LoadGen& operator=(const LoadGen&);
+
+        void plan();
+        bool startConnect(size_t idx);
+        void pump(int timeoutMs);
+        void onWritable(Client& c);
+        void onReadable(Client& c);
+        void onLine(Client& c, const std::string& line);
+        void queue(Client& c, const std::string& data);
+        void flush(Client& c);
+        void kill(Client& c);
+        void sendOne(size_t idx, long long scheduledNs);
+        void printLatency() const;
+
+    public:
+        LoadGen(const LoadOptions& opt, Scenario scenario);
+        ~LoadGen();
+
+        // False when the clients could not even be set up
+        bool run();
+
+        static const char* name(Scenario s);
+};
+
+#endif
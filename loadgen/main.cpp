@@ -0,0 +1,126 @@
+#include "LoadGen.hpp"
+#include <sys/resource.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static void usage(const char* prog)
+{
+	std::fprintf(stderr,
+		"Usage: %s <port> <password> [options]\n"
+		"Options:\n"
+		"  --host <ipv4>            server address (default: 127.0.0.1)\n"
+		"  --scenario <name>        big|small|dm|all (default: all)\n"
+		"  --clients <n>            connections per scenario (default: 1000)\n"
+		"  --channel-size <n>       members per channel for 'small' (default: 10)\n"
+		"  --rate <msgs/s>          PRIVMSG sent per second, all clients together (default: 1000)\n"
+		"  --duration <s>           seconds of load per scenario (default: 10)\n"
+		"  --connect-batch <n>      connects in flight at once (default: 256)\n"
+		"  --io <auto|poll|epoll>   client-side event backend (default: auto)\n",
+		prog);
+}
+
+static bool parseNumber(const char* s, double min, double& out)
+{
+	char* end;
+	out = std::strtod(s, &end);
+	return *s && !*end && out >= min;
+}
+
+// Thousands of sockets need more than the usual 1024 descriptors
+static void raiseFdLimit()
+{
+	struct rlimit rl;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+	{
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	LoadOptions opt;
+	opt.port = std::atoi(argv[1]);
+	opt.password = argv[2];
+	std::string scenario = "all";
+	if (opt.port <= 0 || opt.port > 65535)
+	{
+		std::fprintf(stderr, "Error: port must be between 1 and 65535\n");
+		return 1;
+	}
+
+	for (int i = 3; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			std::fprintf(stderr, "Error: %s needs a value\n", arg.c_str());
+			usage(argv[0]);
+			return 1;
+		}
+		const char* val = argv[++i];
+		double num = 0;
+		bool ok = true;
+
+		if (arg == "--host")
+			opt.host = val;
+		else if (arg == "--scenario")
+			scenario = val;
+		else if (arg == "--io")
+			opt.io = val;
+		else if (arg == "--clients" && (ok = parseNumber(val, 1, num)))
+			opt.clients = static_cast<size_t>(num);
+		else if (arg == "--channel-size" && (ok = parseNumber(val, 2, num)))
+			opt.channelSize = static_cast<size_t>(num);
+		else if (arg == "--rate" && (ok = parseNumber(val, 0, num)))
+			opt.rate = num;
+		else if (arg == "--duration" && (ok = parseNumber(val, 0, num)))
+			opt.duration = num;
+		else if (arg == "--connect-batch" && (ok = parseNumber(val, 1, num)))
+			opt.connectBatch = static_cast<size_t>(num);
+		else if (ok)
+		{
+			std::fprintf(stderr, "Error: unknown option %s\n", arg.c_str());
+			usage(argv[0]);
+			return 1;
+		}
+		if (!ok)
+		{
+			std::fprintf(stderr, "Error: invalid value for %s: %s\n", arg.c_str(), val);
+			return 1;
+		}
+	}
+
+	std::vector<LoadGen::Scenario> runs;
+	if (scenario == "big" || scenario == "all")
+		runs.push_back(LoadGen::BIG_CHANNEL);
+	if (scenario == "small" || scenario == "all")
+		runs.push_back(LoadGen::SMALL_CHANNELS);
+	if (scenario == "dm" || scenario == "all")
+		runs.push_back(LoadGen::DIRECT);
+	if (runs.empty())
+	{
+		std::fprintf(stderr, "Error: unknown scenario %s\n", scenario.c_str());
+		return 1;
+	}
+
+	raiseFdLimit();
+	signal(SIGPIPE, SIG_IGN);
+
+	bool ok = true;
+	for (size_t i = 0; i < runs.size(); ++i)
+	{
+		LoadGen gen(opt, runs[i]);
+		ok = gen.run() && ok;
+	}
+	return ok ? 0 : 1;
+}
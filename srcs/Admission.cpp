@@ -0,0 +1,133 @@
+#include "Admission.hpp"
+
+// AddrTraits
+
+// Fibonacci hashing, with the high half folded into the low bits
+size_t AddrTraits::hash(const uint32_t& addr)
+{
+	unsigned long long h = addr * 0x9E3779B97F4A7C15ULL;
+	return static_cast<size_t>(h ^ (h >> 32));
+}
+
+bool AddrTraits::equal(const uint32_t& a, const uint32_t& b)
+{
+	return a == b;
+}
+
+// Admission
+
+Admission::Host::Host() : addr(0), open(0), current(0), previous(0), start(0)
+{
+}
+
+Admission::Admission(const AdmissionLimits& limits, long nowMs)
+	: _limits(limits), _windowMs(limits.window * 1000L), _expiry(nowMs, 1000),
+	  _hosts(1024)
+{
+	if (_windowMs <= 0)
+		_windowMs = 1000;
+}
+
+bool Admission::enabled() const
+{
+	return _limits.maxPerIp || _limits.rate;
+}
+
+bool Admission::exempt(uint32_t addr) const
+{
+	for (size_t i = 0; i < _limits.exempt.size(); ++i)
+	{
+		if ((addr & _limits.exempt[i].mask) == _limits.exempt[i].net)
+			return true;
+	}
+	return false;
+}
+
+// Moves the fixed window forward to the one holding `now`
+void Admission::roll(Host& h, long now) const
+{
+	long elapsed = now - h.start;
+	if (elapsed < _windowMs)
+		return;
+	h.previous = (elapsed < 2 * _windowMs) ? h.current : 0;
+	h.current = 0;
+	h.start = now - elapsed % _windowMs;
+}
+
+// Connects over the sliding window ending now: all of the current fixed
+// window plus the share of the previous one it still overlaps
+unsigned int Admission::recent(const Host& h, long now) const
+{
+	long overlap = _windowMs - (now - h.start);
+	unsigned long long carried = static_cast<unsigned long long>(h.previous)
+		* overlap / _windowMs;
+	return h.current + static_cast<unsigned int>(carried);
+}
+
+Admission::Verdict Admission::admit(uint32_t addr, long nowMs)
+{
+	if (!enabled() || exempt(addr))
+		return ADMIT;
+
+	Host* h = _hosts.find(addr);
+	if (!h)
+	{
+		Host fresh;
+		fresh.addr = addr;
+		fresh.start = nowMs;
+		h = &_hosts.set(addr, fresh);
+		h->expiry.owner = h;
+	}
+	roll(*h, nowMs);
+
+	Verdict verdict = ADMIT;
+	if (_limits.maxPerIp && h->open >= _limits.maxPerIp)
+		verdict = TOO_MANY;
+	else if (_limits.rate && recent(*h, nowMs) >= _limits.rate)
+		verdict = TOO_FAST;
+
+	if (verdict == ADMIT)
+	{
+		++h->open;
+		++h->current;
+		h->expiry.cancel();
+	}
+	else if (h->open == 0)
+		_expiry.schedule(h->expiry, h->start + 2 * _windowMs);
+	return verdict;
+}
+
+void Admission::release(uint32_t addr, long nowMs)
+{
+	Host* h = _hosts.find(addr);
+	if (!h || h->open == 0)
+		return;
+	if (--h->open > 0)
+		return;
+
+	// Without a rate limit nothing about a closed address is worth keeping
+	if (!_limits.rate)
+	{
+		_hosts.erase(addr);
+		return;
+	}
+	roll(*h, nowMs);
+	_expiry.schedule(h->expiry, h->start + 2 * _windowMs);
+}
+
+void Admission::expire(long nowMs)
+{
+	_expiry.advance(nowMs);
+	Timer* t;
+	while ((t = _expiry.popExpired()) != NULL)
+	{
+		Host* h = static_cast<Host*>(t->owner);
+		if (h->open == 0)
+			_hosts.erase(h->addr);
+	}
+}
+
+size_t Admission::tracked() const
+{
+	return _hosts.size();
+}
@@ -0,0 +1,325 @@
+#include "Config.hpp"
+#include "Tls.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <arpa/inet.h>
+
+ServerConfig::ServerConfig() : ioBackend("auto"), ioThreads(0),
+	preallocSessions(0), preallocRooms(0), logLevel(LOG_INFO),
+	listenBacklog(1024), acceptBatch(64), tlsPort(0), metricsPort(0),
+	commandTiming(false)
+{
+	sendq.low = 64 * 1024;
+	sendq.high = 256 * 1024;
+	sendq.max = 1024 * 1024;
+	flood.burst = 40;
+	flood.rate = 10;
+	timeouts.pingInterval = 120;
+	timeouts.pingTimeout = 60;
+	timeouts.registration = 60;
+	timeouts.idle = 0;
+	admission.maxPerIp = 0;
+	admission.rate = 0;
+	admission.window = 60;
+}
+
+// Accepts 0..max written in plain decimal digits
+static bool parseCount(const std::string& val, size_t max, size_t& out)
+{
+	if (val.empty() || val.size() > 10
+		|| val.find_first_not_of("0123456789") != std::string::npos)
+		return false;
+	size_t n = std::strtoul(val.c_str(), NULL, 10);
+	if (n > max)
+		return false;
+	out = n;
+	return true;
+}
+
+// a.b.c.d or a.b.c.d/len
+static bool parseCidr(const std::string& val, CidrRange& out)
+{
+	std::string addr = val;
+	size_t bits = 32;
+	size_t slash = val.find('/');
+	if (slash != std::string::npos)
+	{
+		if (!parseCount(val.substr(slash + 1), 32, bits))
+			return false;
+		addr = val.substr(0, slash);
+	}
+	struct in_addr in;
+	if (inet_pton(AF_INET, addr.c_str(), &in) != 1)
+		return false;
+	out.mask = bits ? 0xFFFFFFFFu << (32 - bits) : 0;
+	out.net = ntohl(in.s_addr) & out.mask;
+	return true;
+}
+
+void printServerOptions(const char* prog)
+{
+	std::cerr << "Usage: " << prog << " <port> <password> [options]" << std::endl;
+	std::cerr << "Options:" << std::endl;
+	std::cerr << "  --io <auto|poll|epoll|uring>  event backend (default: auto)" << std::endl;
+	std::cerr << "  --threads <0-64>         I/O threads serving client sockets (default: 0, all on one thread)" << std::endl;
+	std::cerr << "  --prealloc-sessions <n>  client slots reserved at startup (default: 0)" << std::endl;
+	std::cerr << "  --prealloc-rooms <n>     channel slots reserved at startup (default: 0)" << std::endl;
+	std::cerr << "  --backlog <1-65535>      listen queue length (default: 1024, capped by somaxconn)" << std::endl;
+	std::cerr << "  --accept-batch <1-4096>  connections accepted per loop tick (default: 64)" << std::endl;
+	std::cerr << "  --sendq-low <bytes>      resume reading below this queue depth (default: 65536)" << std::endl;
+	std::cerr << "  --sendq-high <bytes>     stop reading above this queue depth (default: 262144)" << std::endl;
+	std::cerr << "  --sendq-max <bytes>      disconnect above this queue depth (default: 1048576)" << std::endl;
+	std::cerr << "  --flood-burst <1-10000>  command tokens a client may spend at once (default: 40)" << std::endl;
+	std::cerr << "  --flood-rate <0-10000>   tokens refilled per second, 0 disables (default: 10)" << std::endl;
+	std::cerr << "  --ping-interval <0-86400> seconds between server PINGs, 0 disables (default: 120)" << std::endl;
+	std::cerr << "  --ping-timeout <1-86400> seconds a client has to answer a PING (default: 60)" << std::endl;
+	std::cerr << "  --register-timeout <0-86400> seconds to complete PASS/NICK/USER, 0 disables (default: 60)" << std::endl;
+	std::cerr << "  --idle-timeout <0-86400> disconnect after this many seconds without a command, 0 disables (default: 0)" << std::endl;
+	std::cerr << "  --tls-port <port>        also accept TLS clients on this port (needs --tls-cert and --tls-key)" << std::endl;
+	std::cerr << "  --tls-cert <file>        PEM certificate chain for --tls-port" << std::endl;
+	std::cerr << "  --tls-key <file>         PEM private key for --tls-port" << std::endl;
+	std::cerr << "  --max-per-ip <0-65535>   open connections allowed per address, 0 disables (default: 0)" << std::endl;
+	std::cerr << "  --connect-rate <0-10000> new connections per address per window, 0 disables (default: 0)" << std::endl;
+	std::cerr << "  --connect-window <1-3600> seconds the connect rate is measured over (default: 60)" << std::endl;
+	std::cerr << "  --exempt <addr[/len]>    address range not subject to the above, repeatable" << std::endl;
+	std::cerr << "  --metrics-port <port>    serve Prometheus metrics on 127.0.0.1:<port> (default: off)" << std::endl;
+	std::cerr << "  --oper-password <pass>   password for OPER, which unlocks STATS (default: none)" << std::endl;
+	std::cerr << "  --command-timing <on|off> time every command handler, see STATS c (default: off)" << std::endl;
+	std::cerr << "  --log-level <level>      debug|info|warn|error|off (default: info)" << std::endl;
+}
+
+bool parseServerOptions(int argc, char** argv, int first, ServerConfig& cfg)
+{
+	for (int i = first; i < argc; ++i)
+	{
+		std::string opt = argv[i];
+
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Error: missing value for " << opt << std::endl;
+			return false;
+		}
+		std::string val = argv[++i];
+
+		if (opt == "--io")
+		{
+			if (val != "auto" && val != "poll" && val != "epoll" && val != "uring")
+			{
+				std::cerr << "Error: unknown io backend '" << val << "'" << std::endl;
+				return false;
+			}
+			cfg.ioBackend = val;
+		}
+		else if (opt == "--threads")
+		{
+			int n = std::atoi(val.c_str());
+			if (n < 0 || n > 64 || val.find_first_not_of("0123456789") != std::string::npos)
+			{
+				std::cerr << "Error: --threads expects a number between 0 and 64" << std::endl;
+				return false;
+			}
+			cfg.ioThreads = n;
+		}
+		else if (opt == "--prealloc-sessions")
+		{
+			if (!parseCount(val, 1000000, cfg.preallocSessions))
+			{
+				std::cerr << "Error: --prealloc-sessions expects a number between 0 and 1000000" << std::endl;
+				return false;
+			}
+		}
+		else if (opt == "--prealloc-rooms")
+		{
+			if (!parseCount(val, 1000000, cfg.preallocRooms))
+			{
+				std::cerr << "Error: --prealloc-rooms expects a number between 0 and 1000000" << std::endl;
+				return false;
+			}
+		}
+		else if (opt == "--backlog")
+		{
+			size_t n;
+			if (!parseCount(val, 65535, n) || n == 0)
+			{
+				std::cerr << "Error: --backlog expects a number between 1 and 65535" << std::endl;
+				return false;
+			}
+			cfg.listenBacklog = static_cast<int>(n);
+		}
+		else if (opt == "--accept-batch")
+		{
+			size_t n;
+			if (!parseCount(val, 4096, n) || n == 0)
+			{
+				std::cerr << "Error: --accept-batch expects a number between 1 and 4096" << std::endl;
+				return false;
+			}
+			cfg.acceptBatch = static_cast<int>(n);
+		}
+		else if (opt == "--sendq-low" || opt == "--sendq-high" || opt == "--sendq-max")
+		{
+			size_t n;
+			if (!parseCount(val, 1024 * 1024 * 1024, n) || n == 0)
+			{
+				std::cerr << "Error: " << opt << " expects a byte count between 1 and 1073741824" << std::endl;
+				return false;
+			}
+			if (opt == "--sendq-low")
+				cfg.sendq.low = n;
+			else if (opt == "--sendq-high")
+				cfg.sendq.high = n;
+			else
+				cfg.sendq.max = n;
+		}
+		else if (opt == "--flood-burst" || opt == "--flood-rate")
+		{
+			size_t n;
+			size_t min = (opt == "--flood-burst") ? 1 : 0;
+			if (!parseCount(val, 10000, n) || n < min)
+			{
+				std::cerr << "Error: " << opt << " expects a number between "
+					<< min << " and 10000" << std::endl;
+				return false;
+			}
+			if (opt == "--flood-burst")
+				cfg.flood.burst = static_cast<unsigned int>(n);
+			else
+				cfg.flood.rate = static_cast<unsigned int>(n);
+		}
+		else if (opt == "--ping-interval" || opt == "--ping-timeout"
+			|| opt == "--register-timeout" || opt == "--idle-timeout")
+		{
+			size_t n;
+			size_t min = (opt == "--ping-timeout") ? 1 : 0;
+			if (!parseCount(val, 86400, n) || n < min)
+			{
+				std::cerr << "Error: " << opt << " expects seconds between "
+					<< min << " and 86400" << std::endl;
+				return false;
+			}
+			unsigned int secs = static_cast<unsigned int>(n);
+			if (opt == "--ping-interval")
+				cfg.timeouts.pingInterval = secs;
+			else if (opt == "--ping-timeout")
+				cfg.timeouts.pingTimeout = secs;
+			else if (opt == "--register-timeout")
+				cfg.timeouts.registration = secs;
+			else
+				cfg.timeouts.idle = secs;
+		}
+		else if (opt == "--max-per-ip" || opt == "--connect-rate"
+			|| opt == "--connect-window")
+		{
+			size_t n;
+			size_t min = (opt == "--connect-window") ? 1 : 0;
+			size_t max = (opt == "--max-per-ip") ? 65535
+				: (opt == "--connect-rate") ? 10000 : 3600;
+			if (!parseCount(val, max, n) || n < min)
+			{
+				std::cerr << "Error: " << opt << " expects a number between "
+					<< min << " and " << max << std::endl;
+				return false;
+			}
+			if (opt == "--max-per-ip")
+				cfg.admission.maxPerIp = static_cast<unsigned int>(n);
+			else if (opt == "--connect-rate")
+				cfg.admission.rate = static_cast<unsigned int>(n);
+			else
+				cfg.admission.window = static_cast<unsigned int>(n);
+		}
+		else if (opt == "--exempt")
+		{
+			CidrRange range;
+			if (!parseCidr(val, range))
+			{
+				std::cerr << "Error: --exempt expects an IPv4 address or range, like 10.0.0.0/8" << std::endl;
+				return false;
+			}
+			cfg.admission.exempt.push_back(range);
+		}
+		else if (opt == "--tls-port")
+		{
+			size_t n;
+			if (!parseCount(val, 65535, n) || n == 0)
+			{
+				std::cerr << "Error: --tls-port expects a port between 1 and 65535" << std::endl;
+				return false;
+			}
+			cfg.tlsPort = static_cast<int>(n);
+		}
+		else if (opt == "--tls-cert")
+			cfg.tlsCert = val;
+		else if (opt == "--tls-key")
+			cfg.tlsKey = val;
+		else if (opt == "--metrics-port")
+		{
+			size_t n;
+			if (!parseCount(val, 65535, n) || n == 0)
+			{
+				std::cerr << "Error: --metrics-port expects a port between 1 and 65535" << std::endl;
+				return false;
+			}
+			cfg.metricsPort = static_cast<int>(n);
+		}
+		else if (opt == "--oper-password")
+		{
+			if (val.empty() || val.find_first_of(" \r\n") != std::string::npos)
+			{
+				std::cerr << "Error: --oper-password must be a single non-empty word" << std::endl;
+				return false;
+			}
+			cfg.operPassword = val;
+		}
+		else if (opt == "--command-timing")
+		{
+			if (val != "on" && val != "off")
+			{
+				std::cerr << "Error: --command-timing expects on or off" << std::endl;
+				return false;
+			}
+			cfg.commandTiming = (val == "on");
+		}
+		else if (opt == "--log-level")
+		{
+			if (!Logger::parseLevel(val, cfg.logLevel))
+			{
+				std::cerr << "Error: unknown log level '" << val << "'" << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			std::cerr << "Error: unknown option " << opt << std::endl;
+			return false;
+		}
+	}
+	if (cfg.ioBackend == "uring" && cfg.ioThreads > 0)
+	{
+		std::cerr << "Error: --io uring does its I/O on the main thread and cannot be combined with --threads" << std::endl;
+		return false;
+	}
+	if (cfg.tlsPort)
+	{
+		if (!TlsContext::available())
+		{
+			std::cerr << "Error: this build has no TLS support (rebuild with OpenSSL installed)" << std::endl;
+			return false;
+		}
+		if (cfg.tlsCert.empty() || cfg.tlsKey.empty())
+		{
+			std::cerr << "Error: --tls-port needs --tls-cert and --tls-key" << std::endl;
+			return false;
+		}
+		if (cfg.ioBackend == "uring")
+		{
+			std::cerr << "Error: TLS handshakes run on the poll/epoll loop and cannot be combined with --io uring" << std::endl;
+			return false;
+		}
+	}
+	if (cfg.sendq.low >= cfg.sendq.high || cfg.sendq.high > cfg.sendq.max)
+	{
+		std::cerr << "Error: send queue limits must satisfy low < high <= max" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,339 @@
+#include "IOWorker.hpp"
+#include "Metrics.hpp"
+#include "Logger.hpp"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+
+IOMessage::IOMessage(Kind k, int f, unsigned long id)
+	: kind(k), fd(f), connId(id), next(NULL)
+{
+}
+
+IOWorker::IOWorker(int index, const std::string& backend,
+	const SendQLimits& limits, Mailbox<IOMessage>& coreInbox, Doorbell& coreBell)
+	: _index(index), _backend(backend), _limits(limits), _started(false),
+	  _running(false), _failed(false), _poller(NULL), _coreInbox(coreInbox), _coreBell(coreBell),
+	  _queuedBytes(0), _peakQueue(0), _pausedConns(0), _evicted(0)
+{
+}
+
+IOWorker::~IOWorker()
+{
+	stop();
+	delete _poller;
+}
+
+int IOWorker::getIndex() const { return _index; }
+bool IOWorker::failed() const { return _failed; }
+
+SendQStats IOWorker::sendqStats() const
+{
+	SendQStats s;
+	s.queuedBytes = _queuedBytes;
+	s.peakQueue = _peakQueue;
+	s.paused = _pausedConns;
+	s.evicted = _evicted;
+	return s;
+}
+
+bool IOWorker::start()
+{
+	if (_started || !_bell.isValid())
+		return false;
+
+	_poller = Poller::create(_backend);
+	if (!_poller || !_poller->watch(_bell.fd(), IO_READ))
+		return false;
+
+	// Signals are for the core thread only: the new thread inherits a
+	// mask with them blocked.
+	sigset_t block, prev;
+	sigemptyset(&block);
+	sigaddset(&block, SIGINT);
+	sigaddset(&block, SIGTERM);
+	sigaddset(&block, SIGQUIT);
+	pthread_sigmask(SIG_BLOCK, &block, &prev);
+
+	_running = true;
+	_started = (pthread_create(&_thread, NULL, &IOWorker::entry, this) == 0);
+	pthread_sigmask(SIG_SETMASK, &prev, NULL);
+	return _started;
+}
+
+void IOWorker::stop()
+{
+	if (!_started)
+		return;
+	post(new IOMessage(IOMessage::STOP, -1, 0));
+	pthread_join(_thread, NULL);
+	_started = false;
+}
+
+void IOWorker::post(IOMessage* msg)
+{
+	if (_inbox.post(msg))
+		_bell.ring();
+}
+
+void IOWorker::toCore(IOMessage* msg)
+{
+	if (_coreInbox.post(msg))
+		_coreBell.ring();
+}
+
+void* IOWorker::entry(void* self)
+{
+	static_cast<IOWorker*>(self)->run();
+	return NULL;
+}
+
+void IOWorker::run()
+{
+	while (_running)
+	{
+		int ready = _poller->wait(_events, -1);
+		if (ready < 0 && errno == EINTR)
+			continue;
+		if (ready < 0)
+		{
+			fail();
+			return;
+		}
+
+		for (int i = 0; i < ready; ++i)
+		{
+			int fd = _events[i].fd;
+			int flags = _events[i].flags;
+
+			if (fd == _bell.fd())
+			{
+				_bell.drain();
+				handleInbox();
+				continue;
+			}
+
+			std::map<int, Conn*>::iterator it = _conns.find(fd);
+			if (it == _conns.end() || it->second->dead)
+				continue;
+
+			Conn& conn = *it->second;
+			if (flags & IO_ERROR)
+			{
+				hangup(fd, conn);
+				continue;
+			}
+			if (flags & IO_READ)
+				onReadable(fd, conn);
+			if ((flags & IO_WRITE) && !conn.dead)
+				flushConn(fd, conn);
+		}
+	}
+
+	for (std::map<int, Conn*>::iterator it = _conns.begin();
+		it != _conns.end(); ++it)
+	{
+		close(it->first);
+		delete it->second;
+	}
+	_conns.clear();
+}
+
+// The backend is unusable: every connection goes back to the core as a
+// hangup and the thread exits. From then on the core closes the fds of
+// this worker's sessions itself and hands new ones to the other workers.
+void IOWorker::fail()
+{
+	Log(LOG_ERROR) << "[IO] thread " << _index << ": poll error, stopping";
+	_failed = true;
+	__sync_synchronize();
+	_running = false;
+	handleInbox();
+
+	for (std::map<int, Conn*>::iterator it = _conns.begin();
+		it != _conns.end(); ++it)
+	{
+		hangup(it->first, *it->second);
+		delete it->second;
+	}
+	_conns.clear();
+}
+
+void IOWorker::handleInbox()
+{
+	IOMessage* msg = _inbox.collect();
+
+	while (msg)
+	{
+		IOMessage* next = msg->next;
+		std::map<int, Conn*>::iterator it = _conns.find(msg->fd);
+		bool known = (it != _conns.end() && it->second->id == msg->connId);
+
+		switch (msg->kind)
+		{
+			case IOMessage::ADOPT:
+			{
+				if (it != _conns.end())
+					delete it->second;
+				Conn* conn = new Conn();
+				conn->id = msg->connId;
+				conn->interest = IO_READ;
+				conn->paused = false;
+				conn->dead = false;
+				_conns[msg->fd] = conn;
+				if (!_poller->watch(msg->fd, IO_READ))
+					hangup(msg->fd, *conn);
+				break;
+			}
+
+			case IOMessage::SEND:
+				if (known && !it->second->dead)
+				{
+					// Sent once the socket reports writable, like the core loop
+					Conn& conn = *it->second;
+					size_t before = conn.out.bytes();
+					conn.out.splice(msg->out);
+					trackDepth(conn, before);
+					applyLimits(msg->fd, conn);
+				}
+				break;
+
+			case IOMessage::CLOSE:
+				if (known)
+				{
+					if (!it->second->dead)
+					{
+						forget(*it->second);
+						_poller->unwatch(msg->fd);
+					}
+					close(msg->fd);
+					delete it->second;
+					_conns.erase(it);
+				}
+				break;
+
+			case IOMessage::STOP:
+				_running = false;
+				break;
+
+			default:
+				break;
+		}
+		delete msg;
+		msg = next;
+	}
+}
+
+void IOWorker::onReadable(int fd, Conn& conn)
+{
+	char buf[4096];
+
+	ssize_t n = recv(fd, buf, sizeof(buf), 0);
+	if (n <= 0)
+	{
+		hangup(fd, conn);
+		return;
+	}
+
+	IOMessage* msg = new IOMessage(IOMessage::DATA, fd, conn.id);
+	msg->data.assign(buf, n);
+	toCore(msg);
+}
+
+void IOWorker::flushConn(int fd, Conn& conn)
+{
+	if (!conn.out.empty())
+	{
+		size_t before = conn.out.bytes();
+		ssize_t n = conn.out.flush(fd);
+		trackDepth(conn, before);
+		if (n > 0)
+			serverMetrics().bytesOut.add(n);
+		if (n < 0)
+		{
+			hangup(fd, conn);
+			return;
+		}
+	}
+	applyLimits(fd, conn);
+}
+
+// Keeps the shared depth counters in step with one queue's change
+void IOWorker::trackDepth(Conn& conn, size_t before)
+{
+	size_t after = conn.out.bytes();
+	_queuedBytes = _queuedBytes + after - before;
+	if (after > _peakQueue)
+		_peakQueue = after;
+}
+
+// Send queue watermarks: pause reading above high, resume at low,
+// evict past max
+void IOWorker::applyLimits(int fd, Conn& conn)
+{
+	size_t depth = conn.out.bytes();
+	if (depth > _limits.max)
+	{
+		// Several SENDs may land before the socket is polled again: give
+		// the kernel one chance to take the backlog before judging it.
+		// A failed write shows up on the next poll, so -1 is not fatal.
+		ssize_t n = conn.out.flush(fd);
+		if (n > 0)
+			serverMetrics().bytesOut.add(n);
+		trackDepth(conn, depth);
+		depth = conn.out.bytes();
+	}
+	if (depth > _limits.max)
+	{
+		++_evicted;
+		hangup(fd, conn, "SendQ exceeded");
+		return;
+	}
+	if (!conn.paused && depth > _limits.high)
+	{
+		conn.paused = true;
+		++_pausedConns;
+	}
+	else if (conn.paused && depth <= _limits.low)
+	{
+		conn.paused = false;
+		--_pausedConns;
+	}
+	updateInterest(fd, conn);
+}
+
+void IOWorker::updateInterest(int fd, Conn& conn)
+{
+	int want = (conn.paused ? 0 : IO_READ) | (conn.out.empty() ? 0 : IO_WRITE);
+	if (want != conn.interest && _poller->rewatch(fd, want))
+		conn.interest = want;
+}
+
+// Drops a live connection's share of the counters
+void IOWorker::forget(Conn& conn)
+{
+	size_t before = conn.out.bytes();
+	conn.out.clear();
+	trackDepth(conn, before);
+	if (conn.paused)
+	{
+		conn.paused = false;
+		--_pausedConns;
+	}
+}
+
+// The fd stays open until the core answers with CLOSE, so its number
+// cannot be recycled while the core still knows the old connection.
+void IOWorker::hangup(int fd, Conn& conn, const char* reason)
+{
+	if (conn.dead)
+		return;
+	conn.dead = true;
+	forget(conn);
+	_poller->unwatch(fd);
+	IOMessage* msg = new IOMessage(IOMessage::HANGUP, fd, conn.id);
+	if (reason)
+		msg->data = reason;
+	toCore(msg);
+}
@@ -5,18 +5,88 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <sstream>
 #include <csignal>
-#include <iostream>
+#include "Logger.hpp"
 
 extern volatile sig_atomic_t g_caught_sig;
 
-IRCCore::IRCCore(int port, const std::string& password)
+// Resolution of session deadlines
+static const long kTimerTickMs = 100;
+
+AcceptStats::AcceptStats()
+	: accepted(0), perSecond(0), budgetHits(0), overflows(0),
+	  windowStart(0), windowCount(0), overflowBase(-1)
+{
+}
+
+// TcpExt ListenOverflows from /proc/net/netstat (host-wide), or -1
+static long readListenOverflows()
+{
+	std::ifstream in("/proc/net/netstat");
+	std::string names, values;
+	while (std::getline(in, names) && std::getline(in, values))
+	{
+		if (names.compare(0, 7, "TcpExt:") != 0)
+			continue;
+		std::istringstream n(names), v(values);
+		std::string name, value;
+		while (n >> name && v >> value)
+		{
+			if (name == "ListenOverflows")
+				return std::atol(value.c_str());
+		}
+	}
+	return -1;
+}
+
+IRCCore::IRCCore(int port, const std::string& password,
+	const ServerConfig& config)
 	: _listenSock(-1), _portNum(port), _secret(password),
-	  _hostname("ft_irc"), _active(false)
+	  _hostname("ft_irc"), _config(config), _poller(NULL),
+	  _uring(NULL), _clockMs(monotonicMs()), _timers(_clockMs, kTimerTickMs),
+	  _admission(config.admission, _clockMs), _nextConnId(0), _nextWorker(0),
+	  _metrics(serverMetrics()), _metricsSock(-1), _tlsSock(-1),
+	  _timing(config.commandTiming), _active(false)
 {
-	std::cout << "=== IRC Server Initializing ===" << std::endl;
-	std::cout << "Port: " << port << std::endl;
+	if (_timing)
+		_commandTiming.resize(_commandCount);
+	Log(LOG_INFO) << "=== IRC Server Initializing === port " << port;
+
+	if (_config.ioBackend == "uring")
+		startUring();
+	else
+	{
+		_poller = Poller::create(_config.ioBackend);
+		if (!_poller)
+			fatal("Event backend '" + _config.ioBackend + "' is not available");
+		Log(LOG_INFO) << "Event backend: " << _poller->name();
+	}
+
+	Session::pool().reserve(_config.preallocSessions);
+	Room::pool().reserve(_config.preallocRooms);
+	if (_config.preallocSessions || _config.preallocRooms)
+		logPoolStats();
+
 	initSocket();
+	initTlsSocket();
+	initMetricsSocket();
+	startWorkers();
+}
+
+IRCCore::IRCCore(const ServerConfig& config)
+	: _listenSock(-1), _portNum(0), _hostname("ft_irc"), _config(config),
+	  _poller(NULL), _uring(NULL), _clockMs(monotonicMs()),
+	  _timers(_clockMs, kTimerTickMs), _admission(config.admission, _clockMs),
+	  _nextConnId(0),
+	  _nextWorker(0), _metrics(serverMetrics()), _metricsSock(-1), _tlsSock(-1),
+	  _timing(config.commandTiming), _active(false)
+{
+	if (_timing)
+		_commandTiming.resize(_commandCount);
 }
 
 IRCCore::~IRCCore()
@@ -55,255 +125,494 @@ void IRCCore::initSocket()
 		fatal("Bind failed — port may already be in use");
 	}
 
-	if (listen(_listenSock, 10) < 0)
+	if (listen(_listenSock, _config.listenBacklog) < 0)
 	{
 		close(_listenSock);
 		fatal("Listen failed");
 	}
 
-	struct pollfd pfd;
-	pfd.fd = _listenSock;
-	pfd.events = POLLIN;
-	pfd.revents = 0;
-	_watchers.push_back(pfd);
+	if (_uring ? !uringListen() : !_poller->watch(_listenSock, IO_READ))
+	{
+		close(_listenSock);
+		fatal("Failed to watch listening socket");
+	}
+
+	_acceptStats.overflowBase = readListenOverflows();
+	Log(LOG_INFO) << "Server socket created and listening (backlog "
+		<< _config.listenBacklog << ", " << _config.acceptBatch
+		<< " accepts per tick)";
+}
+
+// Drains the listen queue up to the per-tick budget. The listening socket
+// is level-triggered, so whatever is left is picked up on the next tick.
+void IRCCore::onIncomingConnection(int listenFd)
+{
+	rollAcceptWindow(time(NULL));
 
-	std::cout << "Server socket created and listening" << std::endl;
-	std::cout << "==================================" << std::endl;
+	int budget = _config.acceptBatch;
+	int taken = 0;
+	while (taken < budget && acceptOne(listenFd))
+		++taken;
+	if (taken == budget)
+	{
+		++_acceptStats.budgetHits;
+		_metrics.acceptBudgetHits.add();
+	}
 }
 
-void IRCCore::onIncomingConnection()
+// Returns false once the queue is empty (or accept fails)
+bool IRCCore::acceptOne(int listenFd)
 {
 	struct sockaddr_in peer;
 	socklen_t peerLen = sizeof(peer);
 
-	int fd = accept(_listenSock, (struct sockaddr*)&peer, &peerLen);
+#ifdef SOCK_NONBLOCK
+	int fd = accept4(listenFd, (struct sockaddr*)&peer, &peerLen,
+		SOCK_NONBLOCK | SOCK_CLOEXEC);
 	if (fd < 0)
+		return false;
+#else
+	int fd = accept(listenFd, (struct sockaddr*)&peer, &peerLen);
+	if (fd < 0)
+		return false;
+	if (!enable_nonblock(fd))
+	{
+		Log(LOG_ERROR) << "Failed to set client socket non-blocking";
+		close(fd);
+		return true;
+	}
+#endif
+
+	setupSession(fd, peer, listenFd == _tlsSock);
+	return true;
+}
+
+// Registers a freshly accepted socket with whichever backend serves it,
+// unless its address is over the admission limits. TLS connections stay
+// with the core loop until their handshake is over.
+void IRCCore::setupSession(int fd, const struct sockaddr_in& peer, bool tls)
+{
+	char ip[INET_ADDRSTRLEN] = "unknown";
+	inet_ntop(AF_INET, &peer.sin_addr, ip, INET_ADDRSTRLEN);
+	uint32_t addr = ntohl(peer.sin_addr.s_addr);
+	if (!admitPeer(fd, addr, ip))
 		return;
 
-	if (!enable_nonblock(fd))
+	TlsStream* stream = NULL;
+	if (tls)
+	{
+		stream = new TlsStream(_tlsContext, fd);
+		if (!stream->valid())
+		{
+			Log(LOG_ERROR) << "[TLS] FD " << fd << ": cannot create a TLS session";
+			delete stream;
+			_admission.release(addr, _clockMs);
+			close(fd);
+			return;
+		}
+	}
+	int worker = tls ? -1 : pickWorker();
+	if (_poller && worker < 0 && !_poller->watch(fd, IO_READ))
 	{
-		std::cerr << "Failed to set client socket non-blocking" << std::endl;
+		Log(LOG_ERROR) << "Failed to watch client socket";
+		delete stream;
+		_admission.release(addr, _clockMs);
 		close(fd);
 		return;
 	}
 
-	Session* sess = new Session(fd);
+	Session* sess = new Session(fd, &_pendingWrites);
+	sess->setPeerAddr(addr);
+	sess->setTls(stream);
 	_sessions[fd] = sess;
+	if (worker >= 0)
+		handToWorker(sess, worker);
+	else if (_uring)
+	{
+		sess->attachWorker(-1, ++_nextConnId);
+		sess->setInterest(0);
+		uringSync(sess);
+	}
+	armTimer(*sess);
 
-	struct pollfd pfd;
-	pfd.fd = fd;
-	pfd.events = POLLIN;
-	pfd.revents = 0;
-	_watchers.push_back(pfd);
-
-	char ip[INET_ADDRSTRLEN];
-	inet_ntop(AF_INET, &peer.sin_addr, ip, INET_ADDRSTRLEN);
+	++_acceptStats.accepted;
+	++_acceptStats.windowCount;
+	_metrics.accepted.add();
 
-	std::cout << "\n[NEW CONNECTION]" << std::endl;
-	std::cout << "  FD: " << fd << std::endl;
-	std::cout << "  IP: " << ip << std::endl;
-	std::cout << "  Total clients: " << _sessions.size() << std::endl;
+	Log(LOG_INFO) << "[NEW CONNECTION] FD " << fd << " from " << ip
+		<< (tls ? " over TLS" : "") << " (" << _sessions.size() << " clients)";
 }
 
-void IRCCore::onDataAvailable(int idx)
+// Turns a connection away before anything is allocated for it. The
+// ERROR line is best effort: a fresh socket's buffer takes it or nothing.
+bool IRCCore::admitPeer(int fd, uint32_t addr, const char* ip)
 {
-	char buf[512];
-	memset(buf, 0, sizeof(buf));
+	Admission::Verdict verdict = _admission.admit(addr, _clockMs);
+	if (verdict == Admission::ADMIT)
+		return true;
+
+	std::string reason = (verdict == Admission::TOO_MANY)
+		? "Too many connections from your host"
+		: "Connecting too fast, try again later";
+	std::string line = "ERROR :Closing Link: " + std::string(ip) + " (" + reason + ")\r\n";
+	int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+	send(fd, line.data(), line.size(), flags);
+	close(fd);
 
-	int fd = _watchers[idx].fd;
+	_metrics.rejected.add();
+	Log(LOG_DEBUG) << "[ADMISSION] " << ip << ": " << reason;
+	return false;
+}
 
-	if (_sessions.find(fd) == _sessions.end())
+// Closes the per-second window once the clock has moved on
+void IRCCore::rollAcceptWindow(long now)
+{
+	AcceptStats& st = _acceptStats;
+	if (now == st.windowStart)
 		return;
 
-	Session* sess = _sessions[fd];
+	st.perSecond = (now == st.windowStart + 1) ? st.windowCount : 0;
+	st.windowStart = now;
+	st.windowCount = 0;
 
-	ssize_t n = recv(fd, buf, sizeof(buf) - 1, 0);
+	if (st.overflowBase >= 0 && st.perSecond > 0)
+	{
+		long total = readListenOverflows();
+		unsigned long seen = (total > st.overflowBase) ? total - st.overflowBase : 0;
+		if (seen > st.overflows)
+		{
+			Log(LOG_WARN) << "[ACCEPT] listen queue overflowed "
+				<< (seen - st.overflows) << " times (backlog "
+				<< _config.listenBacklog << ")";
+			_metrics.acceptOverflows.add(seen - st.overflows);
+		}
+		st.overflows = seen;
+	}
+	if (st.perSecond > 0)
+		Log(LOG_DEBUG) << "[ACCEPT] " << st.perSecond << "/s, "
+			<< st.accepted << " total, " << st.budgetHits << " budget hits";
+}
 
+void IRCCore::onDataAvailable(int fd)
+{
+	std::map<int, Session*>::iterator it = _sessions.find(fd);
+	if (it == _sessions.end())
+		return;
+
+	Session* sess = it->second;
+	if (sess->getTls())
+	{
+		onTlsData(sess);
+		return;
+	}
+	ssize_t n = sess->getRecvRing().readFrom(fd);
+
+	if (n < 0 && sess->getRecvRing().full())
+	{
+		Log(LOG_WARN) << "[FLOOD] FD " << fd << " (" << sess->getNick()
+			<< "): deferred input over " << RecvRing::kMax << " bytes";
+		sendClosingLink(sess, "Excess Flood");
+		dropConnection(fd, "Excess Flood");
+		return;
+	}
 	if (n <= 0)
 	{
 		if (n == 0)
-			std::cout << "\n[DISCONNECTION]\n  FD: " << fd << std::endl;
-		dropConnection(idx);
+			Log(LOG_INFO) << "[DISCONNECTION] FD " << fd;
+		dropConnection(fd);
 		return;
 	}
 
-	buf[n] = '\0';
+	_metrics.bytesIn.add(n);
+	processInput(sess);
+}
 
-	// Filter out non-printable / control characters (telnet negotiation, binary junk)
-	std::string filtered;
-	for (ssize_t i = 0; i < n; ++i)
+void IRCCore::ingestData(Session* sess, const char* buf, size_t n)
+{
+	_metrics.bytesIn.add(n);
+	if (!sess->getRecvRing().append(buf, n))
 	{
-		unsigned char c = static_cast<unsigned char>(buf[i]);
-		if (c == '\r' || c == '\n' || (c >= 32 && c <= 126))
-			filtered += static_cast<char>(c);
+		Log(LOG_WARN) << "[FLOOD] FD " << sess->getSocket() << " ("
+			<< sess->getNick() << "): deferred input over "
+			<< RecvRing::kMax << " bytes";
+		sendClosingLink(sess, "Excess Flood");
+		dropConnection(sess->getSocket(), "Excess Flood");
+		return;
 	}
+	processInput(sess);
+}
 
-	if (filtered.empty())
-		return;
+void IRCCore::processInput(Session* sess)
+{
+	int fd = sess->getSocket();
+	RecvRing& ring = sess->getRecvRing();
+	StrView line;
+
+	// Lines are dispatched straight out of the ring, however many one
+	// read brought in; only the unterminated tail stays behind. Once the
+	// flood bucket is spent the rest waits in the ring for a refill.
+	while (floodAllows(*sess))
+	{
+		if (!ring.nextLine(line))
+			break;
+		if (line.empty())
+			continue;
 
-	sess->feedRecvBuf(filtered);
+		dispatch(*sess, line);
 
-	// Protect against oversized buffers (no \n received for too long)
-	if (sess->getRecvBuf().length() > 4096)
-	{
-		std::cout << "\n[FLOOD] FD " << fd << ": buffer limit exceeded, dropping" << std::endl;
-		dropConnection(idx);
-		return;
+		if (_sessions.find(fd) == _sessions.end())
+			return;
 	}
 
-	// Only log if there is visible content (not just \r\n)
-	bool hasVisible = false;
-	for (size_t i = 0; i < filtered.size(); ++i)
+	if (!floodAllows(*sess))
 	{
-		if (filtered[i] != '\r' && filtered[i] != '\n')
+		if (ring.pending() > 0 && !sess->isThrottled())
 		{
-			hasVisible = true;
-			break;
+			sess->setThrottled(true);
+			_throttled.push_back(fd);
+			Log(LOG_DEBUG) << "[FLOOD] FD " << fd << ": deferring "
+				<< ring.pending() << " bytes";
 		}
+		return;
 	}
-	if (hasVisible)
-		std::cout << "\n[RECEIVED] FD " << fd << ": " << filtered;
-
-	std::string pending = sess->getRecvBuf();
-	size_t pos;
 
-	while ((pos = pending.find('\n')) != std::string::npos)
+	// Protect against oversized buffers (no \n received for too long)
+	if (ring.pending() > 4096)
 	{
-		std::string line = pending.substr(0, pos);
-
-		if (!line.empty() && line[line.length() - 1] == '\r')
-			line = line.substr(0, line.length() - 1);
+		Log(LOG_WARN) << "[FLOOD] FD " << fd << ": buffer limit exceeded, dropping";
+		dropConnection(fd);
+		return;
+	}
+}
 
-		pending = pending.substr(pos + 1);
+// Runs the deferred input of every session whose bucket has refilled
+void IRCCore::resumeThrottled()
+{
+	if (_throttled.empty())
+		return;
 
-		if (!line.empty())
+	std::vector<int> waiting;
+	waiting.swap(_throttled);
+	for (size_t i = 0; i < waiting.size(); ++i)
+	{
+		std::map<int, Session*>::iterator it = _sessions.find(waiting[i]);
+		// Gone, or the fd was reused by a session that was never deferred
+		if (it == _sessions.end() || !it->second->isThrottled())
+			continue;
+		Session* sess = it->second;
+		if (!floodAllows(*sess))
 		{
-			dispatch(*sess, line);
-
-			if (_sessions.find(fd) == _sessions.end())
-				return;
+			_throttled.push_back(waiting[i]);
+			continue;
 		}
+		sess->setThrottled(false);
+		processInput(sess);
+		// Input held by OpenSSL gets no readiness event of its own
+		if (_sessions.count(waiting[i]) && !sess->isThrottled()
+			&& sess->getTls() && sess->getTls()->buffered())
+			onTlsData(sess);
 	}
+}
 
-	sess->resetRecvBuf();
-	sess->feedRecvBuf(pending);
-
-	// Update poll flags for all clients that may have queued data
-	for (std::map<int, Session*>::iterator sit = _sessions.begin();
-		sit != _sessions.end(); ++sit)
+// Poll timeout until the earliest deferred session can run again
+int IRCCore::throttleTimeout() const
+{
+	long wait = -1;
+	for (size_t i = 0; i < _throttled.size(); ++i)
 	{
-		refreshPollFlags(sit->first);
+		std::map<int, Session*>::const_iterator it = _sessions.find(_throttled[i]);
+		if (it == _sessions.end())
+			continue;
+		long due = it->second->getFloodClock() - _clockMs;
+		if (due < 1)
+			due = 1;
+		if (wait < 0 || due < wait)
+			wait = due;
 	}
+	return static_cast<int>(wait);
 }
 
-void IRCCore::dropConnection(int idx)
+// Whichever comes first: a deferred session or a session deadline
+int IRCCore::loopTimeout() const
 {
-	int fd = _watchers[idx].fd;
-	Session* sess = _sessions[fd];
+	long wait = throttleTimeout();
+	long timers = _timers.nextTimeout(_clockMs);
+	if (timers >= 0 && (wait < 0 || timers < wait))
+		wait = timers;
+	return static_cast<int>(wait);
+}
 
-	purgeFromRooms(sess);
-	close(fd);
+void IRCCore::dropConnection(int fd, const std::string& reason)
+{
+	std::map<int, Session*>::iterator it = _sessions.find(fd);
+	if (it == _sessions.end())
+		return;
+	Session* sess = it->second;
+
+	purgeFromRooms(sess, reason);
+	_admission.release(sess->getPeerAddr(), _clockMs);
+	if (!sess->getNick().empty())
+		_nickIndex.erase(sess->getNick());
+	if (sess->getWorker() >= 0)
+		releaseFromWorker(sess);
+	else
+	{
+		if (_uring)
+			uringRelease(sess);
+		else
+			_poller->unwatch(fd);
+		if (sess->getTls())
+			sess->getTls()->close();
+		close(fd);
+	}
 	delete sess;
 	_sessions.erase(fd);
-	_watchers.erase(_watchers.begin() + idx);
 
-	std::cout << "  Client removed" << std::endl;
-	std::cout << "  Remaining clients: " << _sessions.size() << std::endl;
+	Log(LOG_INFO) << "[REMOVED] FD " << fd << " (" << _sessions.size()
+		<< " clients left)";
 }
 
 void IRCCore::loop()
 {
 	_active = true;
 
-	std::cout << "\n=== SERVER STARTED ===" << std::endl;
-	std::cout << "Waiting for connections..." << std::endl;
-	std::cout << "Press Ctrl+C to stop\n" << std::endl;
+	Log(LOG_INFO) << "=== SERVER STARTED === waiting for connections (Ctrl+C to stop)";
 
 	while (_active)
 	{
 		if (g_caught_sig)
 		{
-			std::cout << "\n\nReceived interrupt signal" << std::endl;
+			Log(LOG_INFO) << "Received interrupt signal";
 			break;
 		}
 
-		int ready = poll(&_watchers[0], _watchers.size(), -1);
+		if (_uring)
+		{
+			if (!uringTick())
+				break;
+			runTimers();
+			resumeThrottled();
+			flushPendingWrites();
+			continue;
+		}
+
+		int ready = _poller->wait(_events, loopTimeout());
+		_clockMs = monotonicMs();
+		_metrics.wakeups.add();
+		if (ready >= 0)
+			_metrics.eventsPerWakeup.observe(ready);
 
 		if (ready < 0)
 		{
 			if (g_caught_sig)
 				break;
-			std::cerr << "Poll error" << std::endl;
+			Log(LOG_ERROR) << "Poll error";
 			break;
 		}
 
-		for (size_t i = 0; i < _watchers.size(); ++i)
+		// Only ready fds are reported; a handler may drop other sessions,
+		// so every event re-checks that its fd is still known.
+		for (int i = 0; i < ready; ++i)
 		{
-			if (_watchers[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+			int fd = _events[i].fd;
+			int flags = _events[i].flags;
+
+			if (fd == _listenSock || fd == _tlsSock)
 			{
-				if (_watchers[i].fd != _listenSock)
-				{
-					size_t before = _watchers.size();
-					dropConnection(i);
-					if (_watchers.size() < before)
-						--i;
-					continue;
-				}
+				if (flags & IO_READ)
+					onIncomingConnection(fd);
+				continue;
 			}
 
-			if (_watchers[i].revents & POLLIN)
+			if (!_workers.empty() && fd == _coreBell.fd())
 			{
-				if (_watchers[i].fd == _listenSock)
-				{
-					onIncomingConnection();
-				}
-				else
-				{
-					size_t before = _watchers.size();
-					onDataAvailable(i);
-					if (_watchers.size() < before)
-						--i;
-				}
+				onWorkerMessages();
+				continue;
 			}
 
-			if (i < _watchers.size() && (_watchers[i].revents & POLLOUT))
+			if (fd == _metricsSock)
 			{
-				size_t before = _watchers.size();
-				onReadyToSend(i);
-				if (_watchers.size() < before)
-					--i;
+				onMetricsConnection();
+				continue;
 			}
+			if (!_metricsConns.empty() && _metricsConns.count(fd))
+			{
+				onMetricsRequest(fd);
+				continue;
+			}
+
+			if (flags & IO_ERROR)
+			{
+				dropConnection(fd);
+				continue;
+			}
+
+			if (flags & IO_READ)
+				onDataAvailable(fd);
+
+			if ((flags & IO_WRITE) && _sessions.find(fd) != _sessions.end())
+				onReadyToSend(fd);
 		}
+
+		runTimers();
+		resumeThrottled();
+		flushPendingWrites();
 	}
-	std::cout << "\n=== SERVER STOPPED ===" << std::endl;
+	Log(LOG_INFO) << "=== SERVER STOPPED ===";
 }
 
 void IRCCore::shutdown()
 {
 	_active = false;
 
-	std::cout << "\nClosing all connections..." << std::endl;
+	Log(LOG_INFO) << "Closing all connections...";
+	logPoolStats();
+	logSendQStats();
+	logCommandTiming();
+
+	// I/O threads close the sockets they own on their way out
+	stopWorkers();
+
+	// Rooms go first: they unlink themselves from their members
+	for (std::map<std::string, Room*>::iterator it = _rooms.begin();
+		it != _rooms.end(); ++it)
+		delete it->second;
+	_rooms.clear();
 
 	for (std::map<int, Session*>::iterator it = _sessions.begin();
 		it != _sessions.end(); ++it)
 	{
-		close(it->second->getSocket());
+		if (it->second->getWorker() < 0)
+			close(it->second->getSocket());
 		delete it->second;
 	}
 	_sessions.clear();
-
-	for (std::map<std::string, Room*>::iterator it = _rooms.begin();
-		it != _rooms.end(); ++it)
-		delete it->second;
-	_rooms.clear();
+	_nickIndex.clear();
 
 	if (_listenSock >= 0)
 	{
 		close(_listenSock);
 		_listenSock = -1;
 	}
+	if (_tlsSock >= 0)
+	{
+		close(_tlsSock);
+		_tlsSock = -1;
+	}
+	while (!_metricsConns.empty())
+		closeMetrics(_metricsConns.begin()->first);
+	if (_metricsSock >= 0)
+	{
+		close(_metricsSock);
+		_metricsSock = -1;
+	}
 
-	_watchers.clear();
+	delete _poller;
+	_poller = NULL;
+	stopUring();
 
-	std::cout << "Server stopped cleanly." << std::endl;
+	Log(LOG_INFO) << "Server stopped cleanly.";
 }
@@ -1,8 +1,8 @@
 #include "IRCCore.hpp"
 #include <sys/socket.h>
-#include <iostream>
-#include <cctype>
-#include <sstream>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "Logger.hpp"
 
 void IRCCore::enqueueReply(Session& sess, const std::string& message)
 {
@@ -10,7 +10,7 @@ void IRCCore::enqueueReply(Session& sess, const std::string& message)
 	if (msg.length() < 2 || msg.substr(msg.length() - 2) != "\r\n")
 		msg += "\r\n";
 	sess.pushToOutBuf(msg);
-	refreshPollFlags(sess.getSocket());
+	_metrics.linesOut.add();
 }
 
 void IRCCore::replyNumeric(Session& sess, const std::string& code,
@@ -26,53 +26,10 @@ std::string IRCCore::buildPrefix(Session& sess)
 	return ":" + sess.getNick() + "!" + sess.getUser() + "@localhost";
 }
 
-std::string IRCCore::parseVerb(const std::string& raw)
-{
-	size_t start = raw.find_first_not_of(" \t\r");
-	if (start == std::string::npos)
-		return "";
-
-	std::string trimmed = raw.substr(start);
-
-	size_t space = trimmed.find_first_of(" \t");
-	std::string verb = (space != std::string::npos)
-		? trimmed.substr(0, space) : trimmed;
-
-	for (size_t i = 0; i < verb.size(); ++i)
-		verb[i] = std::toupper(verb[i]);
-
-	return verb;
-}
-
-std::string IRCCore::parseArgs(const std::string& raw)
-{
-	size_t start = raw.find_first_not_of(" \t\r");
-	if (start == std::string::npos)
-		return "";
-
-	std::string trimmed = raw.substr(start);
-
-	size_t space = trimmed.find_first_of(" \t");
-	if (space == std::string::npos)
-		return "";
-
-	std::string args = trimmed.substr(space + 1);
-	size_t begin = args.find_first_not_of(" \t");
-	if (begin == std::string::npos)
-		return "";
-
-	return args.substr(begin);
-}
-
 Session* IRCCore::locateByNick(const std::string& nick)
 {
-	for (std::map<int, Session*>::iterator it = _sessions.begin();
-		it != _sessions.end(); ++it)
-	{
-		if (it->second->getNick() == nick)
-			return it->second;
-	}
-	return NULL;
+	Session** found = _nickIndex.find(nick);
+	return found ? *found : NULL;
 }
 
 Room* IRCCore::requireRoom(Session& sess, const std::string& label, bool needOp)
@@ -97,105 +54,269 @@ Room* IRCCore::requireRoom(Session& sess, const std::string& label, bool needOp)
 	return room;
 }
 
-void IRCCore::purgeFromRooms(Session* sess)
+void IRCCore::purgeFromRooms(Session* sess, const std::string& reason)
 {
-	for (std::map<std::string, Room*>::iterator it = _rooms.begin();
-		it != _rooms.end(); )
+	std::string quitLine = buildPrefix(*sess) + " QUIT :" + reason + "\r\n";
+
+	// Copies: eraseUser/removeGuest unlink from the lists being walked
+	std::vector<Room*> invites = sess->getInvites();
+	for (size_t i = 0; i < invites.size(); ++i)
+		invites[i]->removeGuest(sess);
+
+	std::vector<Room*> joined = sess->getRooms();
+	for (size_t i = 0; i < joined.size(); ++i)
 	{
-		std::string quitLine = buildPrefix(*sess) + " QUIT :Connection closed\r\n";
+		Room* room = joined[i];
+		room->relay(quitLine, sess);
+		room->eraseUser(sess);
 
-		if (it->second->hasUser(sess))
+		if (room->getUserList().empty())
 		{
-			it->second->relay(quitLine, sess);
-			flushRoomBuffers(it->second, sess);
+			_rooms.erase(room->getLabel());
+			delete room;
 		}
+	}
+}
 
-		it->second->eraseUser(sess);
+// ERROR line for a client the server is about to drop, best effort like
+// the one admitPeer sends. Inline output goes behind what is already
+// queued; a socket served elsewhere (I/O thread, io_uring) gets it
+// directly, and only if its buffer has room.
+void IRCCore::sendClosingLink(Session* sess, const std::string& reason)
+{
+	char ip[INET_ADDRSTRLEN] = "unknown";
+	struct in_addr addr;
+	addr.s_addr = htonl(sess->getPeerAddr());
+	inet_ntop(AF_INET, &addr, ip, INET_ADDRSTRLEN);
+	std::string line = "ERROR :Closing Link: " + std::string(ip) + " (" + reason + ")\r\n";
 
-		if (it->second->getUserList().empty())
-		{
-			delete it->second;
-			_rooms.erase(it++);
-		}
-		else
-			++it;
+	int fd = sess->getSocket();
+	if (sess->getTls() || (sess->getWorker() < 0 && !_uring))
+	{
+		sess->pushToOutBuf(line);
+		writeOut(sess);
+		// close_notify still has to go out after it
+		if (sess->getTls())
+			return;
 	}
+	else
+	{
+		int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+		flags |= MSG_NOSIGNAL;
+#endif
+		send(fd, line.data(), line.size(), flags);
+	}
+
+	// Closing with unread input resets the connection, and the reset can
+	// destroy the line before the client reads it: end the stream here
+	// and discard what the client still had in flight
+	::shutdown(fd, SHUT_WR);
+	char scrap[4096];
+	for (int i = 0; i < 16 && recv(fd, scrap, sizeof(scrap), MSG_DONTWAIT) > 0; ++i)
+		;
 }
 
+// Inline sockets only; worker-owned output goes through flushPendingWrites.
+// With io_uring the same call arms receives and submits sends instead.
 void IRCCore::refreshPollFlags(int fd)
 {
-	for (size_t i = 0; i < _watchers.size(); ++i)
+	std::map<int, Session*>::iterator it = _sessions.find(fd);
+	if (it == _sessions.end())
+		return;
+
+	// Only talk to the backend when the interest actually changes
+	Session* sess = it->second;
+	if (sess->getWorker() >= 0)
+		return;
+	if (_uring)
 	{
-		if (_watchers[i].fd == fd)
-		{
-			if (_sessions.find(fd) != _sessions.end()
-				&& _sessions[fd]->hasQueuedData())
-				_watchers[i].events = POLLIN | POLLOUT;
-			else
-				_watchers[i].events = POLLIN;
-			return;
-		}
+		uringSync(sess);
+		return;
 	}
+	int want = (sess->isReadPaused() ? 0 : IO_READ)
+		| (sess->hasQueuedData() ? IO_WRITE : 0);
+	if (want != sess->getInterest() && _poller->rewatch(fd, want))
+		sess->setInterest(want);
 }
 
-void IRCCore::onReadyToSend(int idx)
+// Applies the send queue watermarks to an inline session; false once the
+// session has been dropped for exceeding the hard cap
+bool IRCCore::enforceSendQ(Session* sess)
 {
-	int fd = _watchers[idx].fd;
+	OutQueue& out = sess->getOutQueue();
+	size_t depth = out.bytes();
+	if (depth > _sendq.peakQueue)
+		_sendq.peakQueue = depth;
+
+	// One tick can queue more than the socket was offered: let the kernel
+	// take what it can before judging (a failure resurfaces on next poll).
+	// An io_uring send in flight already is that attempt, and a direct
+	// write beside it would reorder bytes.
+	bool sending = _uring && (sess->getInterest() & IO_WRITE);
+	if (depth > _config.sendq.max && !sending)
+	{
+		ssize_t n = writeOut(sess);
+		if (n > 0)
+			_metrics.bytesOut.add(n);
+		depth = out.bytes();
+	}
+	if (depth > _config.sendq.max)
+	{
+		Log(LOG_WARN) << "[SENDQ] FD " << sess->getSocket() << " ("
+			<< sess->getNick() << "): " << depth << " bytes queued, disconnecting";
+		++_sendq.evicted;
+		_metrics.evictions.add();
+		dropConnection(sess->getSocket(), "SendQ exceeded");
+		return false;
+	}
+	if (!sess->isReadPaused() && depth > _config.sendq.high)
+	{
+		sess->setReadPaused(true);
+		Log(LOG_INFO) << "[SENDQ] FD " << sess->getSocket() << ": "
+			<< depth << " bytes queued, reading paused";
+	}
+	else if (sess->isReadPaused() && depth <= _config.sendq.low)
+	{
+		sess->setReadPaused(false);
+		Log(LOG_INFO) << "[SENDQ] FD " << sess->getSocket() << ": drained, reading resumed";
+	}
+	return true;
+}
 
+void IRCCore::onReadyToSend(int fd)
+{
 	if (_sessions.find(fd) == _sessions.end())
 		return;
 
 	Session* sess = _sessions[fd];
-	const std::string& buf = sess->getOutBuf();
+	OutQueue& out = sess->getOutQueue();
 
-	if (buf.empty())
+	if (sess->getTls() && !sess->getTls()->established())
+	{
+		continueHandshake(sess);
+		return;
+	}
+	if (out.empty())
 	{
-		_watchers[idx].events = POLLIN;
+		refreshPollFlags(fd);
 		return;
 	}
 
-	ssize_t n = send(fd, buf.c_str(), buf.length(), 0);
+	ssize_t n = writeOut(sess);
 	if (n > 0)
 	{
-		sess->drainOutBuf(n);
-		if (!sess->hasQueuedData())
-			_watchers[idx].events = POLLIN;
+		_metrics.bytesOut.add(n);
+		if (sess->isReadPaused())
+			enforceSendQ(sess);
+		refreshPollFlags(fd);
 	}
 	else if (n < 0)
+		dropConnection(fd);
+}
+
+// End of tick: only sessions that gained output since the last pass are
+// visited. A dropped session (or a new one on its reused fd) is not dirty.
+void IRCCore::flushPendingWrites()
+{
+	for (size_t i = 0; i < _pendingWrites.size(); ++i)
 	{
-		dropConnection(idx);
+		std::map<int, Session*>::iterator it = _sessions.find(_pendingWrites[i]);
+		if (it == _sessions.end() || !it->second->isDirty())
+			continue;
+
+		Session* sess = it->second;
+		sess->clearDirty();
+		if (sess->getWorker() < 0)
+		{
+			if (enforceSendQ(sess))
+				refreshPollFlags(sess->getSocket());
+			continue;
+		}
+
+		// A worker enforces the limits on what it holds; a single tick can
+		// still overshoot the cap here before anything reaches it
+		if (sess->getOutQueue().bytes() > _config.sendq.max)
+		{
+			Log(LOG_WARN) << "[SENDQ] FD " << sess->getSocket() << " ("
+				<< sess->getNick() << "): tick output over the cap, disconnecting";
+			++_sendq.evicted;
+			_metrics.evictions.add();
+			dropConnection(sess->getSocket(), "SendQ exceeded");
+			continue;
+		}
+		if (!sess->hasQueuedData())
+			continue;
+
+		// Worker-owned socket: the whole queue moves in one message
+		IOMessage* msg = new IOMessage(IOMessage::SEND,
+			sess->getSocket(), sess->getConnId());
+		msg->out.splice(sess->getOutQueue());
+		_workers[sess->getWorker()]->post(msg);
 	}
+	_pendingWrites.clear();
+}
+
+static void printPool(const char* name, const PoolStats& s)
+{
+	Log(LOG_INFO) << "[POOL] " << name << ": " << s.inUse << "/" << s.capacity
+		<< " slots in use (peak " << s.peak << ", " << s.slabs << " slabs of "
+		<< s.objectSize << "-byte slots, " << s.allocations << " allocations)";
+}
+
+void IRCCore::logPoolStats()
+{
+	printPool("sessions", Session::pool().stats());
+	printPool("rooms", Room::pool().stats());
 }
 
-void IRCCore::flushRoomBuffers(Room* room, Session* except)
+// Inline queues are summed on demand; worker queues come from each thread
+SendQStats IRCCore::sendqStats()
 {
-	std::vector<Session*>& users = room->getUserList();
-	for (size_t i = 0; i < users.size(); ++i)
+	SendQStats total = _sendq;
+	for (std::map<int, Session*>::iterator it = _sessions.begin();
+		it != _sessions.end(); ++it)
 	{
-		if (users[i] != except)
-			refreshPollFlags(users[i]->getSocket());
+		total.queuedBytes += it->second->getOutQueue().bytes();
+		if (it->second->isReadPaused())
+			++total.paused;
 	}
+	for (size_t i = 0; i < _workers.size(); ++i)
+		total.add(_workers[i]->sendqStats());
+	return total;
+}
+
+void IRCCore::logSendQStats()
+{
+	SendQStats s = sendqStats();
+	Log(LOG_INFO) << "[SENDQ] " << s.queuedBytes << " bytes queued, deepest queue "
+		<< s.peakQueue << " bytes, " << s.paused << " clients paused, "
+		<< s.evicted << " evicted";
 }
 
-void IRCCore::cmdPing(Session& sess, const std::string& args)
+void IRCCore::cmdPing(Session& sess, const IrcMessage& msg)
 {
-	if (args.empty())
+	if (msg.paramCount == 0 || msg.params[0].empty())
 	{
 		replyNumeric(sess, "409", ":No origin specified");
 		return;
 	}
-	enqueueReply(sess, ":" + _hostname + " PONG " + _hostname + " :" + args);
+	enqueueReply(sess, ":" + _hostname + " PONG " + _hostname + " :"
+		+ msg.params[0].str());
 }
 
-std::vector<std::string> IRCCore::splitComma(const std::string& s)
+std::vector<std::string> IRCCore::splitComma(const StrView& s)
 {
-
-    std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream stream(s);
-	std::cout << s << std::endl;
-    while (std::getline(stream, token, ','))
-        if (!token.empty())
-            tokens.push_back(token);
-    return tokens;
-}
\ No newline at end of file
+	std::vector<std::string> tokens;
+	size_t start = 0;
+	while (start <= s.size())
+	{
+		size_t comma = s.find(',', start);
+		if (comma == StrView::npos)
+			comma = s.size();
+		if (comma > start)
+			tokens.push_back(s.substr(start, comma - start).str());
+		start = comma + 1;
+	}
+	return tokens;
+}
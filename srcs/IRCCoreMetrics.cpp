@@ -0,0 +1,308 @@
+#include "IRCCore.hpp"
+#include "helpers.hpp"
+#include "Logger.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <ctime>
+
+// Metrics endpoint (--metrics-port): a plain HTTP listener bound to the
+// loopback interface, served by the same event loop. A scrape is one
+// request and one response, after which the connection is closed.
+
+static const size_t kMaxScrapers = 16;
+static const size_t kMaxRequest = 4096;
+
+void IRCCore::initMetricsSocket()
+{
+	if (_config.metricsPort <= 0)
+		return;
+
+	_metricsSock = socket(AF_INET, SOCK_STREAM, 0);
+	if (_metricsSock < 0)
+		fatal("Failed to create metrics socket");
+
+	int opt = 1;
+	setsockopt(_metricsSock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+	if (!enable_nonblock(_metricsSock))
+		fatal("Failed to set metrics socket non-blocking");
+
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(_config.metricsPort);
+
+	if (bind(_metricsSock, (struct sockaddr*)&addr, sizeof(addr)) < 0
+		|| listen(_metricsSock, 16) < 0)
+		fatal("Metrics port unavailable — it may already be in use");
+	if (!watchMetrics(_metricsSock, false))
+		fatal("Failed to watch metrics socket");
+
+	Log(LOG_INFO) << "Metrics served on 127.0.0.1:" << _config.metricsPort;
+}
+
+// Readiness for a metrics socket. epoll and poll keep reporting an fd once
+// it is watched; an io_uring poll fires once and is armed again each time.
+bool IRCCore::watchMetrics(int fd, bool again)
+{
+	if (_uring)
+		return uringPollMetrics(fd);
+	return again || _poller->watch(fd, IO_READ);
+}
+
+void IRCCore::onMetricsConnection()
+{
+	int fd = accept(_metricsSock, NULL, NULL);
+	if (fd >= 0)
+	{
+		if (!enable_nonblock(fd))
+			close(fd);
+		else
+		{
+			// A scraper that never sends its request gives way to new ones
+			if (_metricsConns.size() >= kMaxScrapers)
+				closeMetrics(_metricsConns.begin()->first);
+			_metricsConns[fd] = std::string();
+			if (!watchMetrics(fd, false))
+				closeMetrics(fd);
+		}
+	}
+	watchMetrics(_metricsSock, true);
+}
+
+void IRCCore::onMetricsRequest(int fd)
+{
+	std::map<int, std::string>::iterator it = _metricsConns.find(fd);
+	if (it == _metricsConns.end())
+		return;
+
+	char buf[1024];
+	ssize_t n = recv(fd, buf, sizeof(buf), 0);
+	if (n <= 0 || it->second.size() + n > kMaxRequest)
+	{
+		closeMetrics(fd);
+		return;
+	}
+	std::string& req = it->second;
+	req.append(buf, n);
+	if (req.find("\r\n\r\n") == std::string::npos && req.find("\n\n") == std::string::npos)
+	{
+		watchMetrics(fd, true);
+		return;
+	}
+
+	std::string body;
+	std::string status = "200 OK";
+	if (req.compare(0, 13, "GET /metrics ") == 0 || req.compare(0, 6, "GET / ") == 0)
+		renderMetrics(body);
+	else
+	{
+		status = "404 Not Found";
+		body = "Not found\n";
+	}
+
+	std::ostringstream head;
+	head << "HTTP/1.0 " << status << "\r\n"
+		<< "Content-Type: text/plain; version=0.0.4\r\n"
+		<< "Content-Length: " << body.size() << "\r\n"
+		<< "Connection: close\r\n\r\n";
+	std::string reply = head.str() + body;
+
+	// A fresh loopback socket takes the whole page; whatever it does not
+	// is lost rather than kept around for a scraper
+	int flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+	if (send(fd, reply.data(), reply.size(), flags) < static_cast<ssize_t>(reply.size()))
+		Log(LOG_WARN) << "[METRICS] short write, response truncated";
+	closeMetrics(fd);
+}
+
+// Only called for an fd without a readiness request in flight, or with
+// one that is cancelled here
+void IRCCore::closeMetrics(int fd)
+{
+	if (_uring)
+		uringCancelMetrics(fd);
+	else if (_poller)
+		_poller->unwatch(fd);
+	close(fd);
+	_metricsConns.erase(fd);
+}
+
+// Gauges are taken from state the core already keeps, at scrape time
+void IRCCore::renderMetrics(std::string& out)
+{
+	SendQStats q = sendqStats();
+	rollAcceptWindow(time(NULL));
+	_metrics.acceptRate.set(_acceptStats.perSecond);
+	_metrics.sessions.set(_sessions.size());
+	_metrics.rooms.set(_rooms.size());
+	_metrics.trackedHosts.set(_admission.tracked());
+	_metrics.sendqBytes.set(q.queuedBytes);
+	_metrics.sendqPeak.set(q.peakQueue);
+	_metrics.pausedSessions.set(q.paused);
+	_metrics.throttledSessions.set(_throttled.size());
+	PoolStats sp = Session::pool().stats();
+	_metrics.sessionSlotsInUse.set(sp.inUse);
+	_metrics.sessionSlots.set(sp.capacity);
+	_metrics.sessionSlotsPeak.set(sp.peak);
+	PoolStats rp = Room::pool().stats();
+	_metrics.roomSlotsInUse.set(rp.inUse);
+	_metrics.roomSlots.set(rp.capacity);
+	_metrics.roomSlotsPeak.set(rp.peak);
+	_metrics.registry.render(out);
+	renderCommandTiming(out);
+}
+
+// Command timing (--command-timing)
+
+static std::string formatNs(unsigned long long ns)
+{
+	char buf[32];
+	if (ns < 1000)
+		std::snprintf(buf, sizeof(buf), "%lluns", ns);
+	else if (ns < 1000000)
+		std::snprintf(buf, sizeof(buf), "%.1fus", ns / 1e3);
+	else if (ns < 1000000000)
+		std::snprintf(buf, sizeof(buf), "%.1fms", ns / 1e6);
+	else
+		std::snprintf(buf, sizeof(buf), "%.2fs", ns / 1e9);
+	return buf;
+}
+
+// One line per command that ran at least once
+std::vector<std::string> IRCCore::commandTimingLines() const
+{
+	std::vector<std::string> lines;
+	for (size_t i = 0; i < _commandTiming.size(); ++i)
+	{
+		const LatencyHistogram& h = _commandTiming[i].latency;
+		if (h.count() == 0)
+			continue;
+		std::ostringstream line;
+		line << _commands[i].name << " calls " << h.count()
+			<< " p50 " << formatNs(h.percentile(0.5))
+			<< " p99 " << formatNs(h.percentile(0.99))
+			<< " max " << formatNs(h.max())
+			<< " fanout " << _commandTiming[i].fanout;
+		lines.push_back(line.str());
+	}
+	return lines;
+}
+
+// Appended to the metrics page as a summary plus a counter
+void IRCCore::renderCommandTiming(std::string& out) const
+{
+	static const double kQuantiles[] = { 0.5, 0.99 };
+
+	if (_commandTiming.empty())
+		return;
+	std::ostringstream page;
+	page.precision(9);
+	page << "# HELP ircserv_command_duration_seconds Time spent in each command handler\n"
+		<< "# TYPE ircserv_command_duration_seconds summary\n";
+	for (size_t i = 0; i < _commandTiming.size(); ++i)
+	{
+		const LatencyHistogram& h = _commandTiming[i].latency;
+		if (h.count() == 0)
+			continue;
+		const char* name = _commands[i].name;
+		for (size_t q = 0; q < 2; ++q)
+			page << "ircserv_command_duration_seconds{command=\"" << name
+				<< "\",quantile=\"" << kQuantiles[q] << "\"} "
+				<< h.percentile(kQuantiles[q]) / 1e9 << "\n";
+		page << "ircserv_command_duration_seconds{command=\"" << name
+			<< "\",quantile=\"1\"} " << h.max() / 1e9 << "\n"
+			<< "ircserv_command_duration_seconds_sum{command=\"" << name << "\"} "
+			<< h.sum() / 1e9 << "\n"
+			<< "ircserv_command_duration_seconds_count{command=\"" << name << "\"} "
+			<< h.count() << "\n";
+	}
+	page << "# HELP ircserv_command_fanout_total Channel deliveries caused by each command\n"
+		<< "# TYPE ircserv_command_fanout_total counter\n";
+	for (size_t i = 0; i < _commandTiming.size(); ++i)
+	{
+		if (_commandTiming[i].latency.count() == 0)
+			continue;
+		page << "ircserv_command_fanout_total{command=\"" << _commands[i].name
+			<< "\"} " << _commandTiming[i].fanout << "\n";
+	}
+	out += page.str();
+}
+
+void IRCCore::logCommandTiming()
+{
+	std::vector<std::string> lines = commandTimingLines();
+	for (size_t i = 0; i < lines.size(); ++i)
+		Log(LOG_INFO) << "[TIMING] " << lines[i];
+}
+
+// Server operators
+
+void IRCCore::cmdOper(Session& sess, const IrcMessage& msg)
+{
+	if (_config.operPassword.empty())
+	{
+		replyNumeric(sess, "491", ":No O-lines for your host");
+		return;
+	}
+	if (msg.params[1] != StrView(_config.operPassword))
+	{
+		Log(LOG_WARN) << "[OPER] FD " << sess.getSocket() << " (" << sess.getNick()
+			<< "): wrong password";
+		replyNumeric(sess, "464", ":Password incorrect");
+		return;
+	}
+	sess.setOper(true);
+	replyNumeric(sess, "381", ":You are now an IRC operator");
+	Log(LOG_INFO) << "[OPER] " << sess.getNick() << " is now an operator";
+}
+
+// STATS [query]: the metrics page, one 249 line per sample. STATS c
+// lists the command timings instead, STATS l the lag of each client.
+void IRCCore::cmdStats(Session& sess, const IrcMessage& msg)
+{
+	std::string query = msg.paramCount ? msg.params[0].str() : "*";
+	if (!sess.isOper())
+	{
+		replyNumeric(sess, "481", ":Permission Denied- You're not an IRC operator");
+		return;
+	}
+
+	if (query == "c" || query == "C")
+	{
+		std::vector<std::string> lines = commandTimingLines();
+		if (!_timing)
+			replyNumeric(sess, "249", ":Command timing is off (--command-timing on)");
+		for (size_t i = 0; i < lines.size(); ++i)
+			replyNumeric(sess, "249", ":" + lines[i]);
+		replyNumeric(sess, "219", query + " :End of /STATS report");
+		return;
+	}
+	if (query == "l" || query == "L")
+	{
+		sendLagStats(sess);
+		replyNumeric(sess, "219", query + " :End of /STATS report");
+		return;
+	}
+
+	std::string page;
+	renderMetrics(page);
+	size_t pos = 0;
+	while (pos < page.size())
+	{
+		size_t end = page.find('\n', pos);
+		if (end == std::string::npos)
+			end = page.size();
+		if (page[pos] != '#')
+			replyNumeric(sess, "249", ":" + page.substr(pos, end - pos));
+		pos = end + 1;
+	}
+	replyNumeric(sess, "219", query + " :End of /STATS report");
+}
@@ -0,0 +1,128 @@
+#include "IRCCore.hpp"
+#include "Logger.hpp"
+#include <sstream>
+
+// Session deadlines. Each session holds one timer in _timers, armed for
+// whichever deadline of its state comes first: registration before the
+// welcome; afterwards the PONG deadline while a PING is unanswered, the
+// next PING otherwise, and the idle limit. Commands only record when they
+// arrived; the timer checks that when it fires, so busy clients cost no
+// rescheduling.
+
+static long earliest(long a, long b)
+{
+	if (a < 0)
+		return b;
+	return (b < a) ? b : a;
+}
+
+void IRCCore::armTimer(Session& sess)
+{
+	const Timeouts& to = _config.timeouts;
+	long due = -1;
+
+	if (!sess.isWelcomed())
+	{
+		if (to.registration)
+			due = _clockMs + to.registration * 1000L;
+	}
+	else
+	{
+		if (sess.getPingSent() >= 0)
+			due = sess.getPingSent() + to.pingTimeout * 1000L;
+		else if (to.pingInterval)
+			due = sess.getNextPing();
+		if (to.idle)
+			due = earliest(due, sess.getLastActive() + to.idle * 1000L);
+	}
+
+	if (due < 0)
+		sess.getTimer().cancel();
+	else
+		_timers.schedule(sess.getTimer(), due);
+}
+
+void IRCCore::runTimers()
+{
+	_timers.advance(_clockMs);
+	_admission.expire(_clockMs);
+	Timer* t;
+	// A handler may drop other sessions; their timers unlink themselves
+	while ((t = _timers.popExpired()) != NULL)
+		onSessionTimer(static_cast<Session*>(t->owner));
+}
+
+void IRCCore::onSessionTimer(Session* sess)
+{
+	const Timeouts& to = _config.timeouts;
+	int fd = sess->getSocket();
+	std::string reason;
+
+	long sent = sess->getPingSent();
+	if (!sess->isWelcomed())
+		reason = "Registration timeout";
+	else if (sent >= 0 && _clockMs - sent >= to.pingTimeout * 1000L)
+	{
+		std::ostringstream os;
+		os << "Ping timeout: " << (_clockMs - sent) / 1000 << " seconds";
+		reason = os.str();
+	}
+	else if (to.idle && _clockMs - sess->getLastActive() >= to.idle * 1000L)
+		reason = "Idle timeout";
+
+	if (!reason.empty())
+	{
+		Log(LOG_WARN) << "[TIMEOUT] FD " << fd << " (" << sess->getNick()
+			<< "): " << reason;
+		_metrics.timeouts.add();
+		dropConnection(fd, reason);
+		return;
+	}
+
+	if (to.pingInterval && sent < 0 && _clockMs >= sess->getNextPing())
+	{
+		enqueueReply(*sess, "PING :" + _hostname);
+		sess->setPingSent(_clockMs);
+	}
+	armTimer(*sess);
+}
+
+// Answers to the server's PING measure the lag; unsolicited ones are
+// ignored
+void IRCCore::cmdPong(Session& sess, const IrcMessage& msg)
+{
+	(void)msg;
+	long sent = sess.getPingSent();
+	if (sent < 0)
+		return;
+
+	long lag = _clockMs - sent;
+	sess.setLag(lag);
+	sess.setPingSent(-1);
+	sess.setNextPing(sent + _config.timeouts.pingInterval * 1000L);
+	_metrics.lag.observe(lag / 1000.0);
+	Log(LOG_DEBUG) << "[LAG] " << sess.getNick() << ": " << lag << " ms";
+	armTimer(sess);
+}
+
+// STATS l: one 249 line per registered client
+void IRCCore::sendLagStats(Session& sess)
+{
+	for (std::map<int, Session*>::iterator it = _sessions.begin();
+		it != _sessions.end(); ++it)
+	{
+		Session* s = it->second;
+		if (!s->isWelcomed())
+			continue;
+		std::ostringstream line;
+		line << ":" << s->getNick() << " lag ";
+		if (s->getLag() < 0)
+			line << "unknown";
+		else
+			line << s->getLag() << "ms";
+		line << " idle " << (_clockMs - s->getLastActive()) / 1000 << "s";
+		if (s->getPingSent() >= 0)
+			line << " awaiting PONG";
+		replyNumeric(sess, "249", line.str());
+	}
+}
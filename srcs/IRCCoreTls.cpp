@@ -0,0 +1,141 @@
+#include "IRCCore.hpp"
+#include "helpers.hpp"
+#include "Logger.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstring>
+
+// TLS listener (--tls-port): a second listening socket whose connections
+// do their handshake on the core loop. Where the kernel takes over the
+// record layer (kTLS), the session then joins the plaintext paths as it
+// is, I/O threads included. Otherwise the core thread encrypts and
+// decrypts its records in onTlsData() and writeOut().
+
+void IRCCore::initTlsSocket()
+{
+	if (_config.tlsPort <= 0)
+		return;
+
+	std::string error;
+	if (!_tlsContext.load(_config.tlsCert, _config.tlsKey, error))
+		fatal("TLS setup failed: " + error);
+	// OpenSSL writes with write(), which raises SIGPIPE on a reset peer
+	signal(SIGPIPE, SIG_IGN);
+
+	_tlsSock = socket(AF_INET, SOCK_STREAM, 0);
+	if (_tlsSock < 0)
+		fatal("Failed to create TLS socket");
+
+	int opt = 1;
+	setsockopt(_tlsSock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+	if (!enable_nonblock(_tlsSock))
+		fatal("Failed to set TLS socket non-blocking");
+
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_port = htons(_config.tlsPort);
+
+	if (bind(_tlsSock, (struct sockaddr*)&addr, sizeof(addr)) < 0
+		|| listen(_tlsSock, _config.listenBacklog) < 0)
+		fatal("TLS port unavailable — it may already be in use");
+	if (!_poller->watch(_tlsSock, IO_READ))
+		fatal("Failed to watch TLS socket");
+
+	Log(LOG_INFO) << "TLS listening on port " << _config.tlsPort;
+}
+
+void IRCCore::continueHandshake(Session* sess)
+{
+	TlsStream* tls = sess->getTls();
+	int fd = sess->getSocket();
+
+	TlsStream::Status status = tls->handshake();
+	if (status == TlsStream::TLS_FAILED)
+	{
+		Log(LOG_INFO) << "[TLS] FD " << fd << ": handshake failed";
+		dropConnection(fd, "TLS handshake failed");
+		return;
+	}
+	if (status == TlsStream::TLS_AGAIN)
+	{
+		int want = tls->wantsWrite() ? IO_WRITE : IO_READ;
+		if (want != sess->getInterest() && _poller->rewatch(fd, want))
+			sess->setInterest(want);
+		return;
+	}
+
+	_metrics.tlsHandshakes.add();
+	bool kernel = tls->offloaded();
+	Log(LOG_INFO) << "[TLS] FD " << fd << ": " << tls->describe()
+		<< (kernel ? ", records handled by the kernel" : "");
+	if (kernel)
+	{
+		// The socket now reads and writes plaintext
+		_metrics.tlsOffloaded.add();
+		sess->setTls(NULL);
+		delete tls;
+		int worker = pickWorker();
+		if (worker >= 0)
+		{
+			_poller->unwatch(fd);
+			handToWorker(sess, worker);
+			return;
+		}
+	}
+	refreshPollFlags(fd);
+}
+
+// onDataAvailable() for a session with a TLS stream
+void IRCCore::onTlsData(Session* sess)
+{
+	TlsStream* tls = sess->getTls();
+	if (!tls->established())
+	{
+		continueHandshake(sess);
+		return;
+	}
+
+	int fd = sess->getSocket();
+	RecvRing& ring = sess->getRecvRing();
+	for (;;)
+	{
+		ssize_t n = tls->read(ring);
+		if (n < 0 && ring.full())
+		{
+			Log(LOG_WARN) << "[FLOOD] FD " << fd << " (" << sess->getNick()
+				<< "): deferred input over " << RecvRing::kMax << " bytes";
+			sendClosingLink(sess, "Excess Flood");
+			dropConnection(fd, "Excess Flood");
+			return;
+		}
+		if (n < 0)
+		{
+			Log(LOG_INFO) << "[DISCONNECTION] FD " << fd;
+			dropConnection(fd);
+			return;
+		}
+		if (n == 0)
+			return;
+
+		_metrics.bytesIn.add(n);
+		processInput(sess);
+		// A record bigger than the ring's free space is only partly read;
+		// the rest goes once the lines before it are handled
+		if (_sessions.find(fd) == _sessions.end() || sess->isThrottled()
+			|| !tls->buffered())
+			return;
+	}
+}
+
+// Output of an inline session, sealed into records first if TLS is still
+// done in user space; bytes sent, 0 if the socket is full, -1 on error
+ssize_t IRCCore::writeOut(Session* sess)
+{
+	if (sess->getTls())
+		return sess->getTls()->write(sess->getOutQueue());
+	return sess->getOutQueue().flush(sess->getSocket());
+}
@@ -0,0 +1,285 @@
+#include "IRCCore.hpp"
+#include "helpers.hpp"
+#include "Logger.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+// io_uring mode (--io uring): instead of waiting for readiness and then
+// calling recv/send per socket, the loop keeps one multishot accept on the
+// listening socket and one recv per client, and queues a sendmsg for every
+// session with output. All of it is submitted, and the completions reaped,
+// by a single io_uring_enter per tick. A recv is re-armed only once its
+// data has been handled, so, as with poll, a client gets one buffer per
+// tick and a paused one gets none: the shared buffers cannot fill up with
+// input the server is not ready for. The kernel accepts connections as
+// they come, but at most --accept-batch of them become sessions per tick.
+
+// Submission slots, and receive buffers shared by every client
+static const unsigned kRingEntries = 1024;
+static const unsigned kRecvBuffers = 512;
+static const unsigned kRecvBufSize = 4096;
+static const size_t kSendIov = 64;
+
+// Request tags: operation, low bits of the session's connection id (so a
+// completion for a closed fd is never applied to the next session that
+// gets the same number) and the fd itself
+enum { U_ACCEPT = 1, U_RECV, U_SEND, U_CANCEL, U_METRICS };
+
+static uint64_t makeTag(int op, unsigned long connId, int fd)
+{
+	return (static_cast<uint64_t>(op) << 56)
+		| (static_cast<uint64_t>(connId & 0xFFFFFF) << 32)
+		| static_cast<uint32_t>(fd);
+}
+
+static int tagOp(uint64_t tag) { return static_cast<int>(tag >> 56); }
+static int tagFd(uint64_t tag) { return static_cast<int>(tag & 0xFFFFFFFF); }
+static unsigned long tagConn(uint64_t tag) { return (tag >> 32) & 0xFFFFFF; }
+
+// A sendmsg in flight: the kernel reads the header, the iovecs and the
+// chunk bytes until it completes, so all three live here
+struct IRCCore::UringSend {
+	struct msghdr       msg;
+	struct iovec        iov[kSendIov];
+	std::vector<BufRef> keep;
+};
+
+void IRCCore::startUring()
+{
+	_uring = new Uring();
+	if (!_uring->init(kRingEntries, kRecvBuffers, kRecvBufSize))
+		fatal("Event backend 'uring' is not available (needs Linux 5.19+ with io_uring enabled)");
+	Log(LOG_INFO) << "Event backend: io_uring (" << kRecvBuffers << " x "
+		<< kRecvBufSize << "-byte receive buffers)";
+}
+
+void IRCCore::stopUring()
+{
+	// Closing the ring cancels every request; only then can the send
+	// buffers go
+	delete _uring;
+	_uring = NULL;
+	for (std::map<uint64_t, UringSend*>::iterator it = _uringSends.begin();
+		it != _uringSends.end(); ++it)
+		delete it->second;
+	_uringSends.clear();
+	for (size_t i = 0; i < _uringAccepts.size(); ++i)
+		close(_uringAccepts[i]);
+	_uringAccepts.clear();
+}
+
+bool IRCCore::uringListen()
+{
+	return _uring->acceptMultishot(_listenSock, makeTag(U_ACCEPT, 0, _listenSock));
+}
+
+// One loop iteration's worth of kernel work: submit, wait, reap
+bool IRCCore::uringTick()
+{
+	// Connections left over from the last batch are not worth a sleep
+	int rc = _uring->submitAndWait(_uringAccepts.empty() ? loopTimeout() : 0);
+	_clockMs = monotonicMs();
+	if (rc < 0 && rc != -ETIME && rc != -EINTR)
+	{
+		Log(LOG_ERROR) << "io_uring_enter failed: " << std::strerror(-rc);
+		return false;
+	}
+
+	UringCompletion c;
+	size_t reaped = 0;
+	while (_uring->next(c))
+	{
+		onUringCompletion(c);
+		++reaped;
+	}
+	uringSetupAccepted();
+	_metrics.wakeups.add();
+	_metrics.eventsPerWakeup.observe(reaped);
+	return true;
+}
+
+void IRCCore::onUringCompletion(const UringCompletion& c)
+{
+	switch (tagOp(c.tag))
+	{
+		case U_ACCEPT:
+		{
+			if (c.res >= 0)
+				_uringAccepts.push_back(c.res);
+			else
+				Log(LOG_WARN) << "[ACCEPT] " << std::strerror(-c.res);
+			// The kernel ends a multishot accept on errors: start another
+			if (!(c.flags & IORING_CQE_F_MORE) && _listenSock >= 0)
+				uringListen();
+			break;
+		}
+		case U_RECV:
+			onUringRecv(c);
+			break;
+		case U_SEND:
+			onUringSend(c);
+			break;
+		case U_METRICS:
+			// Cancelled polls belong to closed sockets
+			if (c.res < 0)
+				break;
+			if (tagFd(c.tag) == _metricsSock)
+				onMetricsConnection();
+			else
+				onMetricsRequest(tagFd(c.tag));
+			break;
+		default:
+			break;
+	}
+}
+
+// The readiness loop's accept budget, applied to connections the kernel
+// has already accepted: the rest wait, in order, for the next tick
+void IRCCore::uringSetupAccepted()
+{
+	if (_uringAccepts.empty())
+		return;
+	rollAcceptWindow(time(NULL));
+
+	size_t budget = _config.acceptBatch;
+	size_t taken = std::min(budget, _uringAccepts.size());
+	for (size_t i = 0; i < taken; ++i)
+	{
+		struct sockaddr_in peer;
+		socklen_t peerLen = sizeof(peer);
+		std::memset(&peer, 0, sizeof(peer));
+		getpeername(_uringAccepts[i], (struct sockaddr*)&peer, &peerLen);
+		setupSession(_uringAccepts[i], peer);
+	}
+	_uringAccepts.erase(_uringAccepts.begin(), _uringAccepts.begin() + taken);
+	if (taken == budget)
+	{
+		++_acceptStats.budgetHits;
+		_metrics.acceptBudgetHits.add();
+	}
+}
+
+void IRCCore::onUringRecv(const UringCompletion& c)
+{
+	int fd = tagFd(c.tag);
+	std::map<int, Session*>::iterator it = _sessions.find(fd);
+	bool alive = it != _sessions.end()
+		&& (it->second->getConnId() & 0xFFFFFF) == tagConn(c.tag);
+
+	// The buffer goes back as soon as its bytes are in the session's ring
+	if (alive && c.res > 0)
+		ingestData(it->second, _uring->buffer(c), c.res);
+	_uring->recycle(c);
+
+	// Handling the input may have dropped the session
+	it = _sessions.find(fd);
+	if (!alive || it == _sessions.end())
+		return;
+	Session* sess = it->second;
+	sess->setInterest(sess->getInterest() & ~IO_READ);
+
+	if (c.res == 0)
+	{
+		Log(LOG_INFO) << "[DISCONNECTION] FD " << fd;
+		dropConnection(fd);
+	}
+	// Out of buffers: retried on the next tick, after others were returned
+	else if (c.res < 0 && c.res != -ENOBUFS)
+		dropConnection(fd);
+	else
+		uringSync(sess);
+}
+
+void IRCCore::onUringSend(const UringCompletion& c)
+{
+	std::map<uint64_t, UringSend*>::iterator pending = _uringSends.find(c.tag);
+	if (pending != _uringSends.end())
+	{
+		delete pending->second;
+		_uringSends.erase(pending);
+	}
+
+	int fd = tagFd(c.tag);
+	std::map<int, Session*>::iterator it = _sessions.find(fd);
+	if (it == _sessions.end()
+		|| (it->second->getConnId() & 0xFFFFFF) != tagConn(c.tag))
+		return;
+
+	Session* sess = it->second;
+	sess->setInterest(sess->getInterest() & ~IO_WRITE);
+	if (c.res < 0)
+	{
+		dropConnection(fd);
+		return;
+	}
+	sess->getOutQueue().consume(c.res);
+	_metrics.bytesOut.add(c.res);
+	if (enforceSendQ(sess))
+		uringSync(sess);
+}
+
+// Brings the requests in flight for a session in line with its state: a
+// recv unless reading is paused, and one sendmsg while output is queued
+void IRCCore::uringSync(Session* sess)
+{
+	int fd = sess->getSocket();
+	unsigned long conn = sess->getConnId();
+	int have = sess->getInterest();
+
+	// A paused session simply gets no new recv; one already in flight
+	// delivers at most one more buffer
+	if (!sess->isReadPaused() && !(have & IO_READ)
+		&& _uring->recv(fd, makeTag(U_RECV, conn, fd)))
+		have |= IO_READ;
+
+	if (sess->hasQueuedData() && !(have & IO_WRITE))
+	{
+		UringSend* send = new UringSend();
+		std::memset(&send->msg, 0, sizeof(send->msg));
+		send->msg.msg_iov = send->iov;
+		send->msg.msg_iovlen = sess->getOutQueue().gather(send->iov, kSendIov,
+			&send->keep);
+
+		uint64_t tag = makeTag(U_SEND, conn, fd);
+		if (_uring->sendmsg(fd, &send->msg, tag))
+		{
+			_uringSends[tag] = send;
+			have |= IO_WRITE;
+		}
+		else
+			delete send;
+	}
+	sess->setInterest(have);
+}
+
+// The session is going away: cancel what it still has in flight. Late
+// completions carry its connection id and are ignored.
+void IRCCore::uringRelease(Session* sess)
+{
+	int fd = sess->getSocket();
+	unsigned long conn = sess->getConnId();
+	int have = sess->getInterest();
+
+	if (have & IO_READ)
+		_uring->cancel(makeTag(U_RECV, conn, fd), makeTag(U_CANCEL, conn, fd));
+	if (have & IO_WRITE)
+		_uring->cancel(makeTag(U_SEND, conn, fd), makeTag(U_CANCEL, conn, fd));
+}
+
+// Metrics sockets are served synchronously once readable: a one-shot
+// poll per wait
+bool IRCCore::uringPollMetrics(int fd)
+{
+	return _uring->pollIn(fd, makeTag(U_METRICS, 0, fd));
+}
+
+void IRCCore::uringCancelMetrics(int fd)
+{
+	_uring->cancel(makeTag(U_METRICS, 0, fd), makeTag(U_CANCEL, 0, fd));
+}
@@ -0,0 +1,115 @@
+#include "IRCCore.hpp"
+#include "helpers.hpp"
+#include "Logger.hpp"
+#include <unistd.h>
+
+// Threaded mode: sockets are spread over I/O threads which do the
+// recv/send work, while this thread keeps sole ownership of sessions and
+// rooms. Everything crossing the boundary goes through lock-free mailboxes.
+
+void IRCCore::startWorkers()
+{
+	if (_config.ioThreads <= 0)
+		return;
+
+	if (!_coreBell.isValid() || !_poller->watch(_coreBell.fd(), IO_READ))
+		fatal("Failed to set up the I/O thread wakeup pipe");
+
+	for (int i = 0; i < _config.ioThreads; ++i)
+	{
+		IOWorker* worker = new IOWorker(i, _config.ioBackend, _config.sendq,
+			_coreInbox, _coreBell);
+		_workers.push_back(worker);
+		if (!worker->start())
+		{
+			stopWorkers();
+			fatal("Failed to start I/O thread");
+		}
+	}
+	Log(LOG_INFO) << "I/O threads: " << _workers.size();
+}
+
+void IRCCore::stopWorkers()
+{
+	for (size_t i = 0; i < _workers.size(); ++i)
+		delete _workers[i];
+	_workers.clear();
+}
+
+// Next I/O thread in turn that is still running, -1 if there is none (or
+// no I/O threads at all) and the core loop has to serve the socket
+int IRCCore::pickWorker()
+{
+	for (size_t tries = 0; tries < _workers.size(); ++tries)
+	{
+		size_t idx = _nextWorker++ % _workers.size();
+		if (!_workers[idx]->failed())
+			return static_cast<int>(idx);
+	}
+	return -1;
+}
+
+void IRCCore::handToWorker(Session* sess, int worker)
+{
+	sess->attachWorker(worker, ++_nextConnId);
+	_workers[worker]->post(new IOMessage(IOMessage::ADOPT,
+		sess->getSocket(), sess->getConnId()));
+}
+
+void IRCCore::releaseFromWorker(Session* sess)
+{
+	if (_workers[sess->getWorker()]->failed())
+	{
+		close(sess->getSocket());
+		return;
+	}
+	_workers[sess->getWorker()]->post(new IOMessage(IOMessage::CLOSE,
+		sess->getSocket(), sess->getConnId()));
+}
+
+void IRCCore::onWorkerMessages()
+{
+	_coreBell.drain();
+	IOMessage* msg = _coreInbox.collect();
+	size_t ingested = 0;
+
+	while (msg)
+	{
+		IOMessage* next = msg->next;
+
+		// Messages about a connection that was already dropped (and whose
+		// fd may have been reused since) are ignored.
+		std::map<int, Session*>::iterator it = _sessions.find(msg->fd);
+		if (it != _sessions.end() && it->second->getConnId() == msg->connId)
+		{
+			if (msg->kind == IOMessage::DATA)
+			{
+				ingestData(it->second, msg->data.data(), msg->data.size());
+				ingested += msg->data.size();
+			}
+			else if (msg->kind == IOMessage::HANGUP && !msg->data.empty())
+			{
+				// The worker evicted a slow consumer; data holds the reason
+				Log(LOG_WARN) << "[SENDQ] FD " << msg->fd << " ("
+					<< it->second->getNick() << "): " << msg->data;
+				_metrics.evictions.add();
+				dropConnection(msg->fd, msg->data);
+			}
+			else if (msg->kind == IOMessage::HANGUP)
+			{
+				Log(LOG_INFO) << "[DISCONNECTION] FD " << msg->fd;
+				dropConnection(msg->fd);
+			}
+		}
+		delete msg;
+		msg = next;
+
+		// A deep backlog is handed on in slices, so the output of one
+		// wakeup does not pile up here where no send queue limit sees it
+		if (ingested >= 16 * 1024)
+		{
+			flushPendingWrites();
+			ingested = 0;
+		}
+	}
+}
@@ -0,0 +1,112 @@
+#include "IrcMessage.hpp"
+#include <cctype>
+
+const size_t IrcMessage::kMaxParams;
+
+IrcMessage::IrcMessage() : paramCount(0), hasTrailing(false), end(NULL)
+{
+}
+
+bool IrcMessage::is(const char* name) const
+{
+	size_t i = 0;
+	for (; i < command.size(); ++i)
+	{
+		if (!name[i] || std::toupper(static_cast<unsigned char>(command[i])) != name[i])
+			return false;
+	}
+	return name[i] == '\0';
+}
+
+std::string IrcMessage::verb() const
+{
+	std::string v = command.str();
+	for (size_t i = 0; i < v.size(); ++i)
+		v[i] = std::toupper(static_cast<unsigned char>(v[i]));
+	return v;
+}
+
+StrView IrcMessage::param(size_t i) const
+{
+	if (i >= paramCount)
+		return StrView();
+	return params[i];
+}
+
+StrView IrcMessage::rest(size_t i) const
+{
+	if (i >= paramCount)
+		return StrView();
+	return StrView(params[i].data(), end - params[i].data());
+}
+
+// Cursor helpers over [p, end)
+static const char* skipSpaces(const char* p, const char* end)
+{
+	while (p < end && *p == ' ')
+		++p;
+	return p;
+}
+
+static const char* nextSpace(const char* p, const char* end)
+{
+	while (p < end && *p != ' ')
+		++p;
+	return p;
+}
+
+bool parseMessage(const StrView& line, IrcMessage& msg)
+{
+	const char* p = line.data();
+	const char* end = p + line.size();
+
+	msg.tags = StrView();
+	msg.prefix = StrView();
+	msg.command = StrView();
+	msg.paramCount = 0;
+	msg.hasTrailing = false;
+	msg.end = end;
+
+	// Clients typed by hand tend to indent; the grammar itself has no leading blanks
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++p;
+
+	if (p < end && *p == '@')
+	{
+		const char* stop = nextSpace(p, end);
+		msg.tags = StrView(p + 1, stop - p - 1);
+		p = skipSpaces(stop, end);
+	}
+
+	if (p < end && *p == ':')
+	{
+		const char* stop = nextSpace(p, end);
+		msg.prefix = StrView(p + 1, stop - p - 1);
+		p = skipSpaces(stop, end);
+	}
+
+	const char* stop = nextSpace(p, end);
+	if (stop == p)
+		return false;
+	msg.command = StrView(p, stop - p);
+	p = skipSpaces(stop, end);
+
+	while (p < end && msg.paramCount < IrcMessage::kMaxParams)
+	{
+		// ':' starts the trailing parameter, and so does the 15th slot
+		if (*p == ':' || msg.paramCount == IrcMessage::kMaxParams - 1)
+		{
+			if (*p == ':')
+			{
+				msg.hasTrailing = true;
+				++p;
+			}
+			msg.params[msg.paramCount++] = StrView(p, end - p);
+			break;
+		}
+		stop = nextSpace(p, end);
+		msg.params[msg.paramCount++] = StrView(p, stop - p);
+		p = skipSpaces(stop, end);
+	}
+	return true;
+}
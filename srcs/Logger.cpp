@@ -0,0 +1,321 @@
+#include "Logger.hpp"
+#include <sys/time.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+Logger::Record          Logger::_ring[Logger::kSlots];
+size_t volatile         Logger::_tail = 0;
+size_t                  Logger::_head = 0;
+unsigned long volatile  Logger::_dropped = 0;
+int volatile            Logger::_minLevel = LOG_INFO;
+bool volatile           Logger::_running = false;
+bool volatile           Logger::_sleeping = false;
+pthread_mutex_t         Logger::_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t          Logger::_wake = PTHREAD_COND_INITIALIZER;
+pthread_t               Logger::_thread;
+
+static const char* levelName(int level)
+{
+	static const char* names[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+	return (level >= LOG_DEBUG && level <= LOG_ERROR) ? names[level] : "     ";
+}
+
+// Warnings and errors go to stderr, the rest to stdout
+static int levelFd(int level)
+{
+	return (level >= LOG_WARN) ? 2 : 1;
+}
+
+static void writeAll(int fd, const char* data, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = write(fd, data, len);
+		if (n <= 0)
+			return;
+		data += n;
+		len -= n;
+	}
+}
+
+// "HH:MM:SS.mmm LEVEL text\n" into out; returns the length
+static size_t formatLine(char* out, long sec, long usec, int level,
+	const char* text, size_t len)
+{
+	time_t t = sec;
+	struct tm tm;
+	localtime_r(&t, &tm);
+	int n = std::snprintf(out, 32, "%02d:%02d:%02d.%03ld %s ",
+		tm.tm_hour, tm.tm_min, tm.tm_sec, usec / 1000, levelName(level));
+	std::memcpy(out + n, text, len);
+	out[n + len] = '\n';
+	return n + len + 1;
+}
+
+bool Logger::start(LogLevel minLevel)
+{
+	if (_running)
+		return true;
+	_minLevel = minLevel;
+	for (size_t i = 0; i < kSlots; ++i)
+		_ring[i].seq = i;
+	_tail = 0;
+	_head = 0;
+
+	// Same as the I/O threads: signals stay with the core thread
+	sigset_t block, prev;
+	sigemptyset(&block);
+	sigaddset(&block, SIGINT);
+	sigaddset(&block, SIGTERM);
+	sigaddset(&block, SIGQUIT);
+	pthread_sigmask(SIG_BLOCK, &block, &prev);
+
+	_running = true;
+	__sync_synchronize();
+	if (pthread_create(&_thread, NULL, &Logger::entry, NULL) != 0)
+		_running = false;
+	pthread_sigmask(SIG_SETMASK, &prev, NULL);
+	return _running;
+}
+
+// Flushes whatever is still queued, then falls back to direct writes
+void Logger::stop()
+{
+	if (!_running)
+		return;
+	_running = false;
+	__sync_synchronize();
+	wake();
+	pthread_join(_thread, NULL);
+}
+
+bool Logger::enabled(LogLevel level)
+{
+	return level >= _minLevel && level != LOG_OFF;
+}
+
+unsigned long Logger::dropped()
+{
+	return _dropped;
+}
+
+bool Logger::parseLevel(const std::string& name, LogLevel& out)
+{
+	static const char* names[] = { "debug", "info", "warn", "error", "off" };
+	for (int i = LOG_DEBUG; i <= LOG_OFF; ++i)
+	{
+		if (name == names[i])
+		{
+			out = static_cast<LogLevel>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void Logger::push(LogLevel level, const char* text, size_t len)
+{
+	if (len > kTextMax)
+		len = kTextMax;
+
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	if (!_running)
+	{
+		char line[kTextMax + 64];
+		size_t n = formatLine(line, now.tv_sec, now.tv_usec, level, text, len);
+		writeAll(levelFd(level), line, n);
+		return;
+	}
+
+	// Claim a slot whose sequence says it is free for this lap
+	Record* rec;
+	size_t pos = _tail;
+	for (;;)
+	{
+		rec = &_ring[pos % kSlots];
+		size_t seq = rec->seq;
+		__sync_synchronize();
+		long diff = static_cast<long>(seq) - static_cast<long>(pos);
+		if (diff == 0)
+		{
+			if (__sync_bool_compare_and_swap(&_tail, pos, pos + 1))
+				break;
+			pos = _tail;
+		}
+		else if (diff < 0)
+		{
+			__sync_fetch_and_add(&_dropped, 1);
+			return;
+		}
+		else
+			pos = _tail;
+	}
+
+	rec->sec = now.tv_sec;
+	rec->usec = now.tv_usec;
+	rec->level = level;
+	rec->len = len;
+	std::memcpy(rec->text, text, len);
+	__sync_synchronize();
+	rec->seq = pos + 1;
+
+	// Pairs with the barrier in entry(): either the consumer sees this
+	// record before it waits, or this sees it asleep
+	__sync_synchronize();
+	if (_sleeping)
+		wake();
+}
+
+void Logger::wake()
+{
+	pthread_mutex_lock(&_lock);
+	pthread_cond_signal(&_wake);
+	pthread_mutex_unlock(&_lock);
+}
+
+// Formats every published record into per-stream batches, one write each
+bool Logger::drain()
+{
+	static char batch[2][64 * 1024];
+	static unsigned long reported = 0;
+	size_t used[2] = { 0, 0 };
+	bool any = false;
+
+	for (;;)
+	{
+		Record* rec = &_ring[_head % kSlots];
+		if (rec->seq != _head + 1)
+			break;
+		__sync_synchronize();
+
+		int out = levelFd(rec->level) - 1;
+		if (used[out] + kTextMax + 64 > sizeof(batch[out]))
+		{
+			writeAll(out + 1, batch[out], used[out]);
+			used[out] = 0;
+		}
+		used[out] += formatLine(batch[out] + used[out], rec->sec, rec->usec,
+			rec->level, rec->text, rec->len);
+
+		__sync_synchronize();
+		rec->seq = _head + kSlots;
+		++_head;
+		any = true;
+	}
+
+	unsigned long lost = _dropped;
+	if (lost != reported)
+	{
+		char note[64];
+		int n = std::snprintf(note, sizeof(note),
+			"[LOG] %lu records dropped (ring full)", lost - reported);
+		reported = lost;
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		if (used[1] + kTextMax + 64 > sizeof(batch[1]))
+		{
+			writeAll(2, batch[1], used[1]);
+			used[1] = 0;
+		}
+		used[1] += formatLine(batch[1] + used[1], now.tv_sec, now.tv_usec,
+			LOG_WARN, note, n);
+	}
+
+	for (int i = 0; i < 2; ++i)
+	{
+		if (used[i])
+			writeAll(i + 1, batch[i], used[i]);
+	}
+	return any;
+}
+
+void* Logger::entry(void* arg)
+{
+	(void)arg;
+	while (_running)
+	{
+		if (drain())
+			continue;
+
+		// Nothing queued: sleep until a producer or stop() signals
+		pthread_mutex_lock(&_lock);
+		_sleeping = true;
+		__sync_synchronize();
+		if (_running && _ring[_head % kSlots].seq != _head + 1)
+			pthread_cond_wait(&_wake, &_lock);
+		_sleeping = false;
+		pthread_mutex_unlock(&_lock);
+	}
+	drain();
+	return NULL;
+}
+
+// Record builder
+
+Log::Log(LogLevel level)
+	: _level(level), _on(Logger::enabled(level)), _len(0)
+{
+}
+
+Log::~Log()
+{
+	if (_on)
+		Logger::push(_level, _buf, _len);
+}
+
+void Log::append(const char* data, size_t len)
+{
+	if (!_on)
+		return;
+	if (len > Logger::kTextMax - _len)
+		len = Logger::kTextMax - _len;
+	std::memcpy(_buf + _len, data, len);
+	_len += len;
+}
+
+Log& Log::operator<<(const char* s)
+{
+	if (_on)
+		append(s, std::strlen(s));
+	return *this;
+}
+
+Log& Log::operator<<(const std::string& s)
+{
+	append(s.data(), s.size());
+	return *this;
+}
+
+Log& Log::operator<<(const StrView& s)
+{
+	append(s.data(), s.size());
+	return *this;
+}
+
+Log& Log::operator<<(long n)
+{
+	if (_on)
+	{
+		char digits[24];
+		append(digits, std::snprintf(digits, sizeof(digits), "%ld", n));
+	}
+	return *this;
+}
+
+Log& Log::operator<<(unsigned long n)
+{
+	if (_on)
+	{
+		char digits[24];
+		append(digits, std::snprintf(digits, sizeof(digits), "%lu", n));
+	}
+	return *this;
+}
+
+Log& Log::operator<<(int n) { return *this << static_cast<long>(n); }
+Log& Log::operator<<(unsigned int n) { return *this << static_cast<unsigned long>(n); }
@@ -0,0 +1,44 @@
+#include "Mailbox.hpp"
+#include "helpers.hpp"
+#include <unistd.h>
+
+Doorbell::Doorbell()
+{
+	_fds[0] = -1;
+	_fds[1] = -1;
+	if (pipe(_fds) < 0)
+		return;
+	if (!enable_nonblock(_fds[0]) || !enable_nonblock(_fds[1]))
+	{
+		close(_fds[0]);
+		close(_fds[1]);
+		_fds[0] = -1;
+		_fds[1] = -1;
+	}
+}
+
+Doorbell::~Doorbell()
+{
+	if (_fds[0] >= 0)
+		close(_fds[0]);
+	if (_fds[1] >= 0)
+		close(_fds[1]);
+}
+
+bool Doorbell::isValid() const { return _fds[0] >= 0; }
+int Doorbell::fd() const { return _fds[0]; }
+
+void Doorbell::ring()
+{
+	char c = 1;
+	// A full pipe already guarantees a pending wakeup
+	if (write(_fds[1], &c, 1) < 0)
+		return;
+}
+
+void Doorbell::drain()
+{
+	char buf[64];
+	while (read(_fds[0], buf, sizeof(buf)) > 0)
+		;
+}
@@ -0,0 +1,286 @@
+#include "Metrics.hpp"
+#include <cstdio>
+
+// Counter
+
+Counter::Counter() : _value(0)
+{
+}
+
+void Counter::add(unsigned long n)
+{
+	__sync_fetch_and_add(&_value, n);
+}
+
+unsigned long Counter::value() const
+{
+	return _value;
+}
+
+// Gauge
+
+Gauge::Gauge() : _value(0)
+{
+}
+
+void Gauge::set(long v)
+{
+	_value = v;
+}
+
+long Gauge::value() const
+{
+	return _value;
+}
+
+// Histogram
+
+Histogram::Histogram(const double* bounds, size_t count)
+	: _bounds(bounds, bounds + count), _counts(count + 1, 0), _sum(0), _count(0)
+{
+}
+
+void Histogram::observe(double v)
+{
+	size_t i = 0;
+	while (i < _bounds.size() && v > _bounds[i])
+		++i;
+	++_counts[i];
+	_sum += v;
+	++_count;
+}
+
+size_t Histogram::buckets() const { return _bounds.size(); }
+double Histogram::bound(size_t i) const { return _bounds[i]; }
+double Histogram::sum() const { return _sum; }
+unsigned long Histogram::count() const { return _count; }
+
+unsigned long Histogram::cumulative(size_t i) const
+{
+	unsigned long total = 0;
+	for (size_t k = 0; k <= i && k < _counts.size(); ++k)
+		total += _counts[k];
+	return total;
+}
+
+// LatencyHistogram
+
+LatencyHistogram::LatencyHistogram() : _count(0), _sum(0), _max(0)
+{
+	for (unsigned i = 0; i < kBuckets; ++i)
+		_counts[i] = 0;
+}
+
+// Values below kSub get a bucket each; above, the top kSubBits + 1 bits
+// pick the bucket
+unsigned LatencyHistogram::bucketOf(unsigned long long v)
+{
+	if (v < kSub)
+		return static_cast<unsigned>(v);
+	unsigned exp = 63 - __builtin_clzll(v);
+	unsigned sub = static_cast<unsigned>(v >> (exp - kSubBits)) & (kSub - 1);
+	return (exp - kSubBits + 1) * kSub + sub;
+}
+
+unsigned long long LatencyHistogram::upperEdge(unsigned bucket)
+{
+	if (bucket < kSub)
+		return bucket;
+	unsigned shift = bucket / kSub - 1;
+	unsigned long long low = static_cast<unsigned long long>(kSub + bucket % kSub) << shift;
+	return low + ((1ULL << shift) - 1);
+}
+
+void LatencyHistogram::record(unsigned long long ns)
+{
+	++_counts[bucketOf(ns)];
+	++_count;
+	_sum += ns;
+	if (ns > _max)
+		_max = ns;
+}
+
+unsigned long LatencyHistogram::count() const { return _count; }
+unsigned long long LatencyHistogram::sum() const { return _sum; }
+unsigned long long LatencyHistogram::max() const { return _max; }
+
+unsigned long long LatencyHistogram::percentile(double q) const
+{
+	if (_count == 0)
+		return 0;
+	unsigned long want = static_cast<unsigned long>(q * _count + 0.5);
+	if (want == 0)
+		want = 1;
+	unsigned long seen = 0;
+	for (unsigned i = 0; i < kBuckets; ++i)
+	{
+		seen += _counts[i];
+		if (seen >= want)
+		{
+			unsigned long long edge = upperEdge(i);
+			return edge < _max ? edge : _max;
+		}
+	}
+	return _max;
+}
+
+// MetricsRegistry
+
+MetricsRegistry::MetricsRegistry()
+{
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+	for (size_t i = 0; i < _entries.size(); ++i)
+	{
+		if (_entries[i].kind == COUNTER)
+			delete static_cast<Counter*>(_entries[i].metric);
+		else if (_entries[i].kind == GAUGE)
+			delete static_cast<Gauge*>(_entries[i].metric);
+		else
+			delete static_cast<Histogram*>(_entries[i].metric);
+	}
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help)
+{
+	Entry e = { name, help, COUNTER, new Counter() };
+	_entries.push_back(e);
+	return *static_cast<Counter*>(e.metric);
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help)
+{
+	Entry e = { name, help, GAUGE, new Gauge() };
+	_entries.push_back(e);
+	return *static_cast<Gauge*>(e.metric);
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name,
+	const std::string& help, const double* bounds, size_t count)
+{
+	Entry e = { name, help, HISTOGRAM, new Histogram(bounds, count) };
+	_entries.push_back(e);
+	return *static_cast<Histogram*>(e.metric);
+}
+
+static void line(std::string& out, const std::string& name, const char* suffix,
+	const char* labels, double value)
+{
+	char num[64];
+	std::snprintf(num, sizeof(num), "%.17g", value);
+	out += name;
+	out += suffix;
+	out += labels;
+	out += ' ';
+	out += num;
+	out += '\n';
+}
+
+void MetricsRegistry::render(std::string& out) const
+{
+	static const char* kTypes[] = { "counter", "gauge", "histogram" };
+
+	for (size_t i = 0; i < _entries.size(); ++i)
+	{
+		const Entry& e = _entries[i];
+		out += "# HELP " + e.name + " " + e.help + "\n";
+		out += "# TYPE " + e.name + " " + kTypes[e.kind] + "\n";
+
+		if (e.kind == COUNTER)
+			line(out, e.name, "", "", static_cast<Counter*>(e.metric)->value());
+		else if (e.kind == GAUGE)
+			line(out, e.name, "", "", static_cast<Gauge*>(e.metric)->value());
+		else
+		{
+			const Histogram& h = *static_cast<Histogram*>(e.metric);
+			for (size_t b = 0; b < h.buckets(); ++b)
+			{
+				char label[64];
+				std::snprintf(label, sizeof(label), "{le=\"%g\"}", h.bound(b));
+				line(out, e.name, "_bucket", label, h.cumulative(b));
+			}
+			line(out, e.name, "_bucket", "{le=\"+Inf\"}", h.count());
+			line(out, e.name, "_sum", "", h.sum());
+			line(out, e.name, "_count", "", h.count());
+		}
+	}
+}
+
+// ServerMetrics
+
+static const double kLagBounds[] = { 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30 };
+static const double kEventBounds[] = { 0, 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+
+ServerMetrics::ServerMetrics()
+	: bytesIn(registry.counter("ircserv_bytes_received_total",
+		"Bytes read from client sockets")),
+	  bytesOut(registry.counter("ircserv_bytes_sent_total",
+		"Bytes written to client sockets")),
+	  linesIn(registry.counter("ircserv_lines_received_total",
+		"Command lines received")),
+	  linesOut(registry.counter("ircserv_lines_sent_total",
+		"Lines queued for clients, replies and relayed lines")),
+	  relays(registry.counter("ircserv_relays_total",
+		"Lines relayed to a whole channel")),
+	  fanout(registry.counter("ircserv_fanout_deliveries_total",
+		"Copies queued by channel relays")),
+	  accepted(registry.counter("ircserv_connections_accepted_total",
+		"Client connections accepted")),
+	  rejected(registry.counter("ircserv_connections_rejected_total",
+		"Client connections refused by the per-address limits")),
+	  acceptRate(registry.gauge("ircserv_accepts_per_second",
+		"Connections accepted during the last full second")),
+	  acceptOverflows(registry.counter("ircserv_accept_overflows_total",
+		"Listen queue overflows reported by the kernel (host-wide)")),
+	  acceptBudgetHits(registry.counter("ircserv_accept_budget_hits_total",
+		"Loop ticks that hit --accept-batch with connections still queued")),
+	  tlsHandshakes(registry.counter("ircserv_tls_handshakes_total",
+		"TLS handshakes completed")),
+	  tlsOffloaded(registry.counter("ircserv_tls_ktls_total",
+		"TLS connections handed to kernel TLS after the handshake")),
+	  evictions(registry.counter("ircserv_sendq_evictions_total",
+		"Clients disconnected for exceeding the send queue cap")),
+	  timeouts(registry.counter("ircserv_timeouts_total",
+		"Clients disconnected by registration, ping or idle timeouts")),
+	  lag(registry.histogram("ircserv_client_lag_seconds",
+		"Round trip of server PINGs", kLagBounds,
+		sizeof(kLagBounds) / sizeof(kLagBounds[0]))),
+	  sessions(registry.gauge("ircserv_sessions", "Connected clients")),
+	  rooms(registry.gauge("ircserv_rooms", "Channels")),
+	  trackedHosts(registry.gauge("ircserv_admission_tracked_hosts",
+		"Addresses held in the per-address admission table")),
+	  sendqBytes(registry.gauge("ircserv_sendq_bytes",
+		"Output bytes queued, all clients")),
+	  sendqPeak(registry.gauge("ircserv_sendq_peak_bytes",
+		"Deepest single send queue seen")),
+	  pausedSessions(registry.gauge("ircserv_sendq_paused_sessions",
+		"Clients not being read because of their send queue")),
+	  throttledSessions(registry.gauge("ircserv_flood_throttled_sessions",
+		"Clients with input deferred by flood control")),
+	  sessionSlotsInUse(registry.gauge("ircserv_session_pool_in_use",
+		"Session pool slots holding a client")),
+	  sessionSlots(registry.gauge("ircserv_session_pool_capacity",
+		"Session pool slots carved so far")),
+	  sessionSlotsPeak(registry.gauge("ircserv_session_pool_peak",
+		"Most session pool slots in use at once")),
+	  roomSlotsInUse(registry.gauge("ircserv_room_pool_in_use",
+		"Room pool slots holding a channel")),
+	  roomSlots(registry.gauge("ircserv_room_pool_capacity",
+		"Room pool slots carved so far")),
+	  roomSlotsPeak(registry.gauge("ircserv_room_pool_peak",
+		"Most room pool slots in use at once")),
+	  wakeups(registry.counter("ircserv_loop_wakeups_total",
+		"Event loop wakeups")),
+	  eventsPerWakeup(registry.histogram("ircserv_loop_events",
+		"Events handled per event loop wakeup", kEventBounds,
+		sizeof(kEventBounds) / sizeof(kEventBounds[0])))
+{
+}
+
+ServerMetrics& serverMetrics()
+{
+	static ServerMetrics metrics;
+	return metrics;
+}
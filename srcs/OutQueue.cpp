@@ -0,0 +1,158 @@
+#include "OutQueue.hpp"
+#include <sys/socket.h>
+#include <cstring>
+
+// Iovecs handed to the kernel per flush, and the chunk size used to pack
+// small private replies (numerics, PONGs) together
+static const size_t kMaxIov = 64;
+static const size_t kPackChunk = 1024;
+
+OutQueue::OutQueue() : _headOffset(0), _bytes(0), _tailPrivate(false)
+{
+}
+
+OutQueue::~OutQueue()
+{
+}
+
+void OutQueue::push(const BufRef& chunk)
+{
+	if (chunk.size() == 0)
+		return;
+	_chunks.push_back(chunk);
+	_bytes += chunk.size();
+	_tailPrivate = false;
+}
+
+void OutQueue::push(const std::string& bytes)
+{
+	push(bytes.data(), bytes.size());
+}
+
+void OutQueue::push(const char* data, size_t len)
+{
+	if (len == 0)
+		return;
+	if (_tailPrivate && _chunks.back().tryAppend(data, len))
+	{
+		_bytes += len;
+		return;
+	}
+	_chunks.push_back(BufRef(data, len, len < kPackChunk ? kPackChunk : len));
+	_bytes += len;
+	_tailPrivate = true;
+}
+
+bool OutQueue::empty() const { return _bytes == 0; }
+size_t OutQueue::bytes() const { return _bytes; }
+size_t OutQueue::chunkCount() const { return _chunks.size(); }
+
+void OutQueue::consume(size_t n)
+{
+	if (n > _bytes)
+		n = _bytes;
+	_bytes -= n;
+
+	while (n > 0 && !_chunks.empty())
+	{
+		size_t left = _chunks.front().size() - _headOffset;
+		if (n < left)
+		{
+			_headOffset += n;
+			return;
+		}
+		n -= left;
+		_chunks.pop_front();
+		_headOffset = 0;
+	}
+	if (_chunks.empty())
+		_tailPrivate = false;
+}
+
+size_t OutQueue::gather(struct iovec* iov, size_t max,
+	std::vector<BufRef>* keep) const
+{
+	size_t count = 0;
+	for (std::deque<BufRef>::const_iterator it = _chunks.begin();
+		it != _chunks.end() && count < max; ++it, ++count)
+	{
+		size_t skip = (count == 0) ? _headOffset : 0;
+		iov[count].iov_base = const_cast<char*>(it->data() + skip);
+		iov[count].iov_len = it->size() - skip;
+		if (keep)
+			keep->push_back(*it);
+	}
+	return count;
+}
+
+ssize_t OutQueue::flush(int fd)
+{
+	if (_chunks.empty())
+		return 0;
+
+	struct iovec iov[kMaxIov];
+	size_t count = gather(iov, kMaxIov);
+
+	struct msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+
+	int flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+	ssize_t n = sendmsg(fd, &msg, flags);
+	if (n > 0)
+		consume(n);
+	return n;
+}
+
+void OutQueue::splice(OutQueue& from)
+{
+	if (from.empty())
+		return;
+
+	if (empty())
+	{
+		_chunks.swap(from._chunks);
+		_headOffset = from._headOffset;
+		_bytes = from._bytes;
+		_tailPrivate = from._tailPrivate;
+		from.clear();
+		return;
+	}
+
+	// Keep from's partially sent head chunk intact by copying its tail
+	if (from._headOffset)
+	{
+		const BufRef& head = from._chunks.front();
+		push(BufRef(head.data() + from._headOffset, head.size() - from._headOffset));
+		from._chunks.pop_front();
+	}
+	for (size_t i = 0; i < from._chunks.size(); ++i)
+		push(from._chunks[i]);
+	_tailPrivate = from._tailPrivate;
+	from.clear();
+}
+
+void OutQueue::clear()
+{
+	_chunks.clear();
+	_headOffset = 0;
+	_bytes = 0;
+	_tailPrivate = false;
+}
+
+SendQStats::SendQStats() : queuedBytes(0), peakQueue(0), paused(0), evicted(0)
+{
+}
+
+void SendQStats::add(const SendQStats& other)
+{
+	queuedBytes += other.queuedBytes;
+	if (other.peakQueue > peakQueue)
+		peakQueue = other.peakQueue;
+	paused += other.paused;
+	evicted += other.evicted;
+}
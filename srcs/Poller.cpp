@@ -0,0 +1,226 @@
+#include "Poller.hpp"
+#include <unistd.h>
+
+Poller::Poller()
+{
+}
+
+Poller::~Poller()
+{
+}
+
+Poller* Poller::create(const std::string& kind)
+{
+#ifdef __linux__
+	if (kind == "epoll" || kind == "auto")
+	{
+		EpollPoller* ep = new EpollPoller();
+		if (ep->isValid())
+			return ep;
+		delete ep;
+		if (kind == "epoll")
+			return NULL;
+	}
+#else
+	if (kind == "epoll")
+		return NULL;
+#endif
+	if (kind == "poll" || kind == "auto")
+		return new PollPoller();
+	return NULL;
+}
+
+// poll() backend
+
+static short toPollEvents(int interest)
+{
+	short ev = 0;
+	if (interest & IO_READ)
+		ev |= POLLIN;
+	if (interest & IO_WRITE)
+		ev |= POLLOUT;
+	return ev;
+}
+
+PollPoller::PollPoller()
+{
+}
+
+PollPoller::~PollPoller()
+{
+}
+
+int PollPoller::slotOf(int fd) const
+{
+	if (fd < 0 || (size_t)fd >= _slotOf.size())
+		return -1;
+	return _slotOf[fd];
+}
+
+bool PollPoller::watch(int fd, int interest)
+{
+	if (fd < 0 || slotOf(fd) >= 0)
+		return false;
+	if ((size_t)fd >= _slotOf.size())
+		_slotOf.resize(fd + 1, -1);
+
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = toPollEvents(interest);
+	pfd.revents = 0;
+	_slotOf[fd] = _fds.size();
+	_fds.push_back(pfd);
+	return true;
+}
+
+bool PollPoller::rewatch(int fd, int interest)
+{
+	int slot = slotOf(fd);
+	if (slot < 0)
+		return false;
+	_fds[slot].events = toPollEvents(interest);
+	return true;
+}
+
+void PollPoller::unwatch(int fd)
+{
+	int slot = slotOf(fd);
+	if (slot < 0)
+		return;
+
+	// Swap-remove: move the last entry into the freed slot
+	int last = _fds.size() - 1;
+	if (slot != last)
+	{
+		_fds[slot] = _fds[last];
+		_slotOf[_fds[slot].fd] = slot;
+	}
+	_fds.pop_back();
+	_slotOf[fd] = -1;
+}
+
+int PollPoller::wait(std::vector<IOEvent>& out, int timeoutMs)
+{
+	out.clear();
+	if (_fds.empty())
+		return 0;
+
+	int ready = poll(&_fds[0], _fds.size(), timeoutMs);
+	if (ready <= 0)
+		return ready;
+
+	for (size_t i = 0; i < _fds.size() && (int)out.size() < ready; ++i)
+	{
+		short rev = _fds[i].revents;
+		if (!rev)
+			continue;
+
+		IOEvent ev;
+		ev.fd = _fds[i].fd;
+		ev.flags = 0;
+		if (rev & POLLIN)
+			ev.flags |= IO_READ;
+		if (rev & POLLOUT)
+			ev.flags |= IO_WRITE;
+		if (rev & (POLLERR | POLLHUP | POLLNVAL))
+			ev.flags |= IO_ERROR;
+		out.push_back(ev);
+	}
+	return out.size();
+}
+
+const char* PollPoller::name() const { return "poll"; }
+
+#ifdef __linux__
+
+// epoll backend
+
+static uint32_t toEpollEvents(int interest)
+{
+	uint32_t ev = 0;
+	if (interest & IO_READ)
+		ev |= EPOLLIN;
+	if (interest & IO_WRITE)
+		ev |= EPOLLOUT;
+	return ev;
+}
+
+EpollPoller::EpollPoller() : _epfd(epoll_create1(EPOLL_CLOEXEC)), _watched(0)
+{
+	_ready.resize(64);
+}
+
+EpollPoller::~EpollPoller()
+{
+	if (_epfd >= 0)
+		close(_epfd);
+}
+
+bool EpollPoller::isValid() const { return _epfd >= 0; }
+
+bool EpollPoller::watch(int fd, int interest)
+{
+	struct epoll_event ev;
+	ev.events = toEpollEvents(interest);
+	ev.data.u64 = 0;
+	ev.data.fd = fd;
+	if (epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return false;
+	++_watched;
+	return true;
+}
+
+bool EpollPoller::rewatch(int fd, int interest)
+{
+	struct epoll_event ev;
+	ev.events = toEpollEvents(interest);
+	ev.data.u64 = 0;
+	ev.data.fd = fd;
+	return epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EpollPoller::unwatch(int fd)
+{
+	struct epoll_event ev;
+	ev.events = 0;
+	ev.data.u64 = 0;
+	if (epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, &ev) == 0 && _watched > 0)
+		--_watched;
+}
+
+int EpollPoller::wait(std::vector<IOEvent>& out, int timeoutMs)
+{
+	out.clear();
+
+	// Let the ready buffer follow the connection count so one wakeup can
+	// drain a burst, without ever allocating per call.
+	size_t want = _watched < 64 ? 64 : _watched;
+	if (want > 4096)
+		want = 4096;
+	if (_ready.size() < want)
+		_ready.resize(want);
+
+	int ready = epoll_wait(_epfd, &_ready[0], _ready.size(), timeoutMs);
+	if (ready <= 0)
+		return ready;
+
+	for (int i = 0; i < ready; ++i)
+	{
+		uint32_t rev = _ready[i].events;
+		IOEvent ev;
+		ev.fd = _ready[i].data.fd;
+		ev.flags = 0;
+		if (rev & EPOLLIN)
+			ev.flags |= IO_READ;
+		if (rev & EPOLLOUT)
+			ev.flags |= IO_WRITE;
+		if (rev & (EPOLLERR | EPOLLHUP))
+			ev.flags |= IO_ERROR;
+		out.push_back(ev);
+	}
+	return ready;
+}
+
+const char* EpollPoller::name() const { return "epoll"; }
+
+#endif
@@ -0,0 +1,143 @@
+#include "RecvRing.hpp"
+#include <sys/uio.h>
+#include <cstring>
+
+const size_t RecvRing::kInitial;
+const size_t RecvRing::kMax;
+const size_t RecvRing::kReadMin;
+
+RecvRing::RecvRing() : _buf(NULL), _cap(0), _head(0), _tail(0), _scanned(0)
+{
+}
+
+RecvRing::~RecvRing()
+{
+	delete[] _buf;
+}
+
+size_t RecvRing::pending() const { return _tail - _head; }
+
+bool RecvRing::full() const
+{
+	return _cap >= kMax && _cap - pending() < kReadMin;
+}
+
+char& RecvRing::at(size_t pos) { return _buf[pos & (_cap - 1)]; }
+
+bool RecvRing::reserve(size_t extra)
+{
+	size_t used = pending();
+	if (_cap - used >= extra)
+		return true;
+
+	size_t cap = _cap ? _cap : kInitial;
+	while (cap - used < extra && cap < kMax)
+		cap *= 2;
+	if (cap == _cap)
+		return _cap > used;
+
+	// Growing linearizes the pending bytes once; reads never move them
+	char* grown = new char[cap];
+	for (size_t i = 0; i < used; ++i)
+		grown[i] = at(_head + i);
+	delete[] _buf;
+	_buf = grown;
+	_cap = cap;
+	_head = 0;
+	_tail = used;
+	return _cap > used;
+}
+
+ssize_t RecvRing::readFrom(int fd)
+{
+	if (!reserve(kReadMin))
+		return -1;
+
+	size_t space = _cap - pending();
+	size_t pos = _tail & (_cap - 1);
+	size_t first = _cap - pos;
+	if (first > space)
+		first = space;
+
+	struct iovec iov[2];
+	iov[0].iov_base = _buf + pos;
+	iov[0].iov_len = first;
+	iov[1].iov_base = _buf;
+	iov[1].iov_len = space - first;
+
+	ssize_t n = readv(fd, iov, iov[1].iov_len ? 2 : 1);
+	if (n > 0)
+		_tail += n;
+	return n;
+}
+
+bool RecvRing::append(const char* data, size_t len)
+{
+	if (!reserve(len) || _cap - pending() < len)
+		return false;
+
+	size_t pos = _tail & (_cap - 1);
+	size_t first = _cap - pos;
+	if (first > len)
+		first = len;
+	std::memcpy(_buf + pos, data, first);
+	std::memcpy(_buf, data + first, len - first);
+	_tail += len;
+	return true;
+}
+
+bool RecvRing::nextLine(StrView& line)
+{
+	size_t used = pending();
+
+	// Look for '\n' only in bytes not scanned by a previous call
+	size_t nl = used;
+	while (_scanned < used)
+	{
+		size_t pos = (_head + _scanned) & (_cap - 1);
+		size_t chunk = _cap - pos;
+		if (chunk > used - _scanned)
+			chunk = used - _scanned;
+		const void* hit = std::memchr(_buf + pos, '\n', chunk);
+		if (hit)
+		{
+			nl = _scanned + (static_cast<const char*>(hit) - (_buf + pos));
+			break;
+		}
+		_scanned += chunk;
+	}
+	if (nl == used)
+		return false;
+
+	char* text;
+	size_t start = _head & (_cap - 1);
+	if (start + nl <= _cap)
+		text = _buf + start;
+	else
+	{
+		_wrapped.assign(_buf + start, _cap - start);
+		_wrapped.append(_buf, nl - (_cap - start));
+		text = &_wrapped[0];
+	}
+
+	// Drop control characters (telnet negotiation, binary junk) in place
+	size_t len = 0;
+	for (size_t i = 0; i < nl; ++i)
+	{
+		unsigned char c = static_cast<unsigned char>(text[i]);
+		if (c == '\r' || (c >= 32 && c <= 126))
+			text[len++] = c;
+	}
+	if (len > 0 && text[len - 1] == '\r')
+		--len;
+
+	line = StrView(text, len);
+	_head += nl + 1;
+	_scanned = 0;
+	if (_head == _tail)
+	{
+		_head = 0;
+		_tail = 0;
+	}
+	return true;
+}
@@ -1,14 +1,50 @@
 #include "Room.hpp"
 #include "Session.hpp"
-#include <algorithm>
+#include "SharedBuffer.hpp"
+#include "Metrics.hpp"
 
 Room::Room(const std::string& label)
-	: _label(label), _restricted(false), _lockedSubject(false), _maxUsers(0)
+	: _label(label), _members(8), _namesStale(false), _restricted(false),
+	  _lockedSubject(false), _maxUsers(0)
 {
 }
 
+// Collects invited non-members for the destructor
+struct Room::GuestCollector {
+	std::vector<Session*> guests;
+	void operator()(Session* s, const Member& m)
+	{
+		if (m.flags & MEMBER_INVITED)
+			guests.push_back(s);
+	}
+};
+
+// Guests are not members, so their back-references outlive the last PART
 Room::~Room()
 {
+	GuestCollector collect;
+	_members.forEach(collect);
+	for (size_t i = 0; i < collect.guests.size(); ++i)
+		collect.guests[i]->unlinkInvite(this);
+	for (size_t i = 0; i < _users.size(); ++i)
+		_users[i]->unlinkRoom(this);
+}
+
+SlabPool& Room::pool()
+{
+	static SlabPool rooms(sizeof(Room), 64);
+	return rooms;
+}
+
+void* Room::operator new(size_t size)
+{
+	(void)size;
+	return pool().allocate();
+}
+
+void Room::operator delete(void* p)
+{
+	pool().release(p);
 }
 
 std::string Room::getLabel() const { return _label; }
@@ -17,7 +53,7 @@ std::string Room::getPassphrase() const { return _passphrase; }
 bool Room::isRestricted() const { return _restricted; }
 bool Room::hasLockedSubject() const { return _lockedSubject; }
 int Room::getMaxUsers() const { return _maxUsers; }
-std::vector<Session*>& Room::getUserList() { return _users; }
+const std::vector<Session*>& Room::getUserList() const { return _users; }
 
 void Room::changeSubject(const std::string& subject) { _subject = subject; }
 void Room::changePassphrase(const std::string& pass) { _passphrase = pass; }
@@ -25,73 +61,176 @@ void Room::toggleRestricted(bool on) { _restricted = on; }
 void Room::toggleLockedSubject(bool on) { _lockedSubject = on; }
 void Room::setMaxUsers(int cap) { _maxUsers = cap; }
 
-void Room::insertUser(Session* s)
+// Flag table
+
+unsigned int Room::memberFlags(Session* s) const
 {
-	if (!hasUser(s))
-		_users.push_back(s);
+	const Member* m = _members.find(s);
+	return m ? m->flags : 0;
 }
 
-void Room::eraseUser(Session* s)
+bool Room::hasFlag(Session* s, unsigned int flag) const
 {
-	std::vector<Session*>::iterator it = std::find(_users.begin(), _users.end(), s);
-	if (it != _users.end())
-		_users.erase(it);
-	demoteAdmin(s);
-	removeGuest(s);
+	return (memberFlags(s) & flag) != 0;
 }
 
-bool Room::hasUser(Session* s) const
+void Room::setFlag(Session* s, unsigned int flag)
 {
-	return std::find(_users.begin(), _users.end(), s) != _users.end();
+	Member* m = _members.find(s);
+	if (m)
+		m->flags |= flag;
+	else
+	{
+		Member fresh;
+		fresh.flags = flag;
+		fresh.slot = 0;
+		_members.set(s, fresh);
+	}
 }
 
-void Room::promoteAdmin(Session* s)
+// Drops the entry once no flag is left
+void Room::clearFlag(Session* s, unsigned int flag)
 {
-	if (!isAdmin(s))
-		_admins.push_back(s);
+	Member* m = _members.find(s);
+	if (!m)
+		return;
+	m->flags &= ~flag;
+	if (m->flags == 0)
+		_members.erase(s);
 }
 
-void Room::demoteAdmin(Session* s)
+// NAMES cache
+
+std::string Room::nameToken(Session* s) const
 {
-	std::vector<Session*>::iterator it = std::find(_admins.begin(), _admins.end(), s);
-	if (it != _admins.end())
-		_admins.erase(it);
+	return (isAdmin(s) ? " @" : " ") + s->getNick();
 }
 
-bool Room::isAdmin(Session* s) const
+// Rebuilt lazily, so a mass PART or QUIT costs one pass over the members
+// instead of a search through the list for each of them
+const std::string& Room::getNames() const
 {
-	return std::find(_admins.begin(), _admins.end(), s) != _admins.end();
+	if (_namesStale)
+	{
+		_names.clear();
+		for (size_t i = 0; i < _users.size(); ++i)
+			_names += nameToken(_users[i]);
+		_namesStale = false;
+	}
+	return _names;
 }
 
-void Room::addGuest(Session* s)
+void Room::renameUser(Session* s)
 {
-	if (!isGuest(s))
-		_guestList.push_back(s);
+	if (hasUser(s))
+		_namesStale = true;
 }
 
-bool Room::isGuest(Session* s) const
+// User management
+
+void Room::insertUser(Session* s)
 {
-	return std::find(_guestList.begin(), _guestList.end(), s) != _guestList.end();
+	if (hasUser(s))
+		return;
+	setFlag(s, MEMBER_JOINED);
+	_members.find(s)->slot = _users.size();
+	_users.push_back(s);
+	if (!_namesStale)
+		_names += nameToken(s);
+	s->linkRoom(this);
 }
 
+// Swap-remove keeps _users dense; the moved member's slot is patched
+void Room::eraseUser(Session* s)
+{
+	Member* m = _members.find(s);
+	if (!m)
+		return;
+	if (m->flags & MEMBER_JOINED)
+	{
+		_namesStale = true;
+		size_t slot = m->slot;
+		Session* last = _users.back();
+		_users[slot] = last;
+		_members.find(last)->slot = slot;
+		_users.pop_back();
+		s->unlinkRoom(this);
+	}
+	if (m->flags & MEMBER_INVITED)
+		s->unlinkInvite(this);
+	_members.erase(s);
+}
+
+bool Room::hasUser(Session* s) const { return hasFlag(s, MEMBER_JOINED); }
+
+// Admin management
+
+void Room::promoteAdmin(Session* s)
+{
+	if (!hasUser(s) || isAdmin(s))
+		return;
+	setFlag(s, MEMBER_OP);
+	_namesStale = true;
+}
+
+void Room::demoteAdmin(Session* s)
+{
+	if (!isAdmin(s))
+		return;
+	clearFlag(s, MEMBER_OP);
+	_namesStale = true;
+}
+bool Room::isAdmin(Session* s) const { return hasFlag(s, MEMBER_OP); }
+
+// Guest list
+
+void Room::addGuest(Session* s)
+{
+	if (isGuest(s))
+		return;
+	setFlag(s, MEMBER_INVITED);
+	s->linkInvite(this);
+}
+
+bool Room::isGuest(Session* s) const { return hasFlag(s, MEMBER_INVITED); }
+
 void Room::removeGuest(Session* s)
 {
-	std::vector<Session*>::iterator it = std::find(_guestList.begin(), _guestList.end(), s);
-	if (it != _guestList.end())
-		_guestList.erase(it);
+	if (!isGuest(s))
+		return;
+	clearFlag(s, MEMBER_INVITED);
+	s->unlinkInvite(this);
+}
+
+// One update per relay rather than per member
+void Room::countRelay(size_t recipients)
+{
+	ServerMetrics& m = serverMetrics();
+	m.relays.add();
+	m.fanout.add(recipients);
+	m.linesOut.add(recipients);
 }
 
+// The line is serialized once; each member queue only takes a reference
 void Room::relay(const std::string& msg, Session* except)
 {
+	BufRef line(msg);
+	size_t sent = 0;
 	for (size_t i = 0; i < _users.size(); ++i)
 	{
 		if (_users[i] != except)
-			_users[i]->pushToOutBuf(msg);
+		{
+			_users[i]->pushToOutBuf(line);
+			++sent;
+		}
 	}
+	countRelay(sent);
 }
 
 void Room::relayAll(const std::string& msg)
 {
+	BufRef line(msg);
 	for (size_t i = 0; i < _users.size(); ++i)
-		_users[i]->pushToOutBuf(msg);
+		_users[i]->pushToOutBuf(line);
+	countRelay(_users.size());
 }
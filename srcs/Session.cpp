@@ -1,17 +1,43 @@
 #include "Session.hpp"
+#include "Poller.hpp"
+#include "Tls.hpp"
+#include <algorithm>
 
-Session::Session(int fd) : _sockFd(fd), _passOk(false), _welcomed(false)
+Session::Session(int fd, std::vector<int>* pendingWrites)
+	: _sockFd(fd), _passOk(false), _welcomed(false), _oper(false), _interest(IO_READ),
+	  _readPaused(false), _worker(-1), _connId(0), _dirty(false),
+	  _floodClock(0), _throttled(false), _lastActive(0), _nextPing(0),
+	  _pingSent(-1), _lag(-1), _peerAddr(0), _tls(NULL),
+	  _pendingWrites(pendingWrites)
 {
+	_timer.owner = this;
 }
 
 Session::~Session()
 {
+	delete _tls;
+}
+
+SlabPool& Session::pool()
+{
+	static SlabPool sessions(sizeof(Session), 256);
+	return sessions;
+}
+
+void* Session::operator new(size_t size)
+{
+	(void)size;
+	return pool().allocate();
+}
+
+void Session::operator delete(void* p)
+{
+	pool().release(p);
 }
 
 int Session::getSocket() const { return _sockFd; }
 std::string Session::getNick() const { return _nick; }
 std::string Session::getUser() const { return _user; }
-std::string Session::getRecvBuf() const { return _recvBuf; }
 bool Session::hasValidPass() const { return _passOk; }
 bool Session::isWelcomed() const { return _welcomed; }
 
@@ -19,11 +45,83 @@ void Session::setNick(const std::string& nick) { _nick = nick; }
 void Session::setUser(const std::string& user) { _user = user; }
 void Session::markPassOk(bool ok) { _passOk = ok; }
 void Session::markWelcomed(bool w) { _welcomed = w; }
+bool Session::isOper() const { return _oper; }
+void Session::setOper(bool oper) { _oper = oper; }
+
+RecvRing& Session::getRecvRing() { return _recvRing; }
+
+// The first push of a tick lists the session once for the write pass
+void Session::markDirty()
+{
+	if (_dirty)
+		return;
+	_dirty = true;
+	if (_pendingWrites)
+		_pendingWrites->push_back(_sockFd);
+}
+
+void Session::pushToOutBuf(const std::string& data)
+{
+	_outQueue.push(data);
+	markDirty();
+}
+
+void Session::pushToOutBuf(const BufRef& line)
+{
+	_outQueue.push(line);
+	markDirty();
+}
+
+OutQueue& Session::getOutQueue() { return _outQueue; }
+bool Session::hasQueuedData() const { return !_outQueue.empty(); }
+bool Session::isDirty() const { return _dirty; }
+void Session::clearDirty() { _dirty = false; }
+long Session::getFloodClock() const { return _floodClock; }
+void Session::setFloodClock(long ms) { _floodClock = ms; }
+bool Session::isThrottled() const { return _throttled; }
+void Session::setThrottled(bool throttled) { _throttled = throttled; }
+
+Timer& Session::getTimer() { return _timer; }
+long Session::getLastActive() const { return _lastActive; }
+void Session::setLastActive(long ms) { _lastActive = ms; }
+long Session::getNextPing() const { return _nextPing; }
+void Session::setNextPing(long ms) { _nextPing = ms; }
+long Session::getPingSent() const { return _pingSent; }
+void Session::setPingSent(long ms) { _pingSent = ms; }
+long Session::getLag() const { return _lag; }
+void Session::setLag(long ms) { _lag = ms; }
+
+unsigned int Session::getPeerAddr() const { return _peerAddr; }
+void Session::setPeerAddr(unsigned int addr) { _peerAddr = addr; }
+
+TlsStream* Session::getTls() const { return _tls; }
+void Session::setTls(TlsStream* tls) { _tls = tls; }
+int Session::getInterest() const { return _interest; }
+void Session::setInterest(int flags) { _interest = flags; }
+bool Session::isReadPaused() const { return _readPaused; }
+void Session::setReadPaused(bool paused) { _readPaused = paused; }
 
-void Session::feedRecvBuf(const std::string& chunk) { _recvBuf += chunk; }
-void Session::resetRecvBuf() { _recvBuf.clear(); }
+int Session::getWorker() const { return _worker; }
+unsigned long Session::getConnId() const { return _connId; }
+
+void Session::attachWorker(int worker, unsigned long connId)
+{
+	_worker = worker;
+	_connId = connId;
+}
+
+const std::vector<Room*>& Session::getRooms() const { return _rooms; }
+const std::vector<Room*>& Session::getInvites() const { return _invites; }
+
+// A client sits in a handful of rooms, so a flat vector beats a tree here
+static void unlinkFrom(std::vector<Room*>& list, Room* room)
+{
+	std::vector<Room*>::iterator it = std::find(list.begin(), list.end(), room);
+	if (it != list.end())
+		list.erase(it);
+}
 
-void Session::pushToOutBuf(const std::string& data) { _outBuf += data; }
-const std::string& Session::getOutBuf() const { return _outBuf; }
-void Session::drainOutBuf(size_t bytes) { _outBuf.erase(0, bytes); }
-bool Session::hasQueuedData() const { return !_outBuf.empty(); }
+void Session::linkRoom(Room* room) { _rooms.push_back(room); }
+void Session::unlinkRoom(Room* room) { unlinkFrom(_rooms, room); }
+void Session::linkInvite(Room* room) { _invites.push_back(room); }
+void Session::unlinkInvite(Room* room) { unlinkFrom(_invites, room); }
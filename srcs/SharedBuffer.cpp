@@ -0,0 +1,99 @@
+#include "SharedBuffer.hpp"
+#include <cstring>
+#include <new>
+
+SharedBuffer::SharedBuffer(size_t size, size_t capacity)
+	: _refs(1), _size(size), _capacity(capacity)
+{
+}
+
+SharedBuffer::~SharedBuffer()
+{
+}
+
+SharedBuffer* SharedBuffer::create(const char* data, size_t len,
+	size_t capacity)
+{
+	if (capacity < len)
+		capacity = len;
+	void* mem = ::operator new(sizeof(SharedBuffer) + capacity);
+	SharedBuffer* buf = new (mem) SharedBuffer(len, capacity);
+	if (len)
+		std::memcpy(reinterpret_cast<char*>(buf + 1), data, len);
+	return buf;
+}
+
+void SharedBuffer::retain()
+{
+	__sync_add_and_fetch(&_refs, 1);
+}
+
+void SharedBuffer::release()
+{
+	if (__sync_sub_and_fetch(&_refs, 1) == 0)
+	{
+		this->~SharedBuffer();
+		::operator delete(this);
+	}
+}
+
+const char* SharedBuffer::data() const
+{
+	return reinterpret_cast<const char*>(this + 1);
+}
+
+size_t SharedBuffer::size() const { return _size; }
+
+bool SharedBuffer::tryAppend(const char* data, size_t len)
+{
+	if (_refs != 1 || _capacity - _size < len)
+		return false;
+	std::memcpy(reinterpret_cast<char*>(this + 1) + _size, data, len);
+	_size += len;
+	return true;
+}
+
+BufRef::BufRef() : _buf(NULL)
+{
+}
+
+BufRef::BufRef(const std::string& bytes)
+	: _buf(SharedBuffer::create(bytes.data(), bytes.size()))
+{
+}
+
+BufRef::BufRef(const char* data, size_t len, size_t capacity)
+	: _buf(SharedBuffer::create(data, len, capacity))
+{
+}
+
+BufRef::BufRef(const BufRef& other) : _buf(other._buf)
+{
+	if (_buf)
+		_buf->retain();
+}
+
+BufRef& BufRef::operator=(const BufRef& other)
+{
+	if (other._buf)
+		other._buf->retain();
+	if (_buf)
+		_buf->release();
+	_buf = other._buf;
+	return *this;
+}
+
+BufRef::~BufRef()
+{
+	if (_buf)
+		_buf->release();
+}
+
+bool BufRef::isNull() const { return _buf == NULL; }
+const char* BufRef::data() const { return _buf ? _buf->data() : NULL; }
+size_t BufRef::size() const { return _buf ? _buf->size() : 0; }
+
+bool BufRef::tryAppend(const char* data, size_t len)
+{
+	return _buf && _buf->tryAppend(data, len);
+}
@@ -0,0 +1,74 @@
+#include "SlabPool.hpp"
+#include <new>
+
+// Every slot keeps the alignment operator new guarantees for the slab
+static const size_t kSlotAlign = 16;
+
+SlabPool::SlabPool(size_t objectSize, size_t perSlab)
+	: _objectSize(objectSize), _perSlab(perSlab ? perSlab : 1), _free(NULL),
+	  _capacity(0), _inUse(0), _peak(0), _allocations(0)
+{
+	if (_objectSize < sizeof(FreeSlot))
+		_objectSize = sizeof(FreeSlot);
+	_objectSize = (_objectSize + kSlotAlign - 1) & ~(kSlotAlign - 1);
+}
+
+SlabPool::~SlabPool()
+{
+	for (size_t i = 0; i < _slabs.size(); ++i)
+		::operator delete(_slabs[i]);
+}
+
+// Slots are pushed in reverse so the first allocations walk the slab forward
+void SlabPool::addSlab(size_t count)
+{
+	char* slab = static_cast<char*>(::operator new(_objectSize * count));
+	_slabs.push_back(slab);
+	_capacity += count;
+	for (size_t i = count; i > 0; --i)
+	{
+		FreeSlot* slot = reinterpret_cast<FreeSlot*>(slab + (i - 1) * _objectSize);
+		slot->next = _free;
+		_free = slot;
+	}
+}
+
+void* SlabPool::allocate()
+{
+	if (!_free)
+		addSlab(_perSlab);
+	FreeSlot* slot = _free;
+	_free = slot->next;
+	if (++_inUse > _peak)
+		_peak = _inUse;
+	++_allocations;
+	return slot;
+}
+
+void SlabPool::release(void* p)
+{
+	if (!p)
+		return;
+	FreeSlot* slot = static_cast<FreeSlot*>(p);
+	slot->next = _free;
+	_free = slot;
+	--_inUse;
+}
+
+void SlabPool::reserve(size_t count)
+{
+	if (count > _capacity)
+		addSlab(count - _capacity);
+}
+
+PoolStats SlabPool::stats() const
+{
+	PoolStats s;
+	s.objectSize = _objectSize;
+	s.slabs = _slabs.size();
+	s.capacity = _capacity;
+	s.inUse = _inUse;
+	s.peak = _peak;
+	s.allocations = _allocations;
+	return s;
+}
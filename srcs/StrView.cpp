@@ -0,0 +1,37 @@
+#include "StrView.hpp"
+#include <cstring>
+
+const size_t StrView::npos;
+
+StrView::StrView(const char* cstr) : _data(cstr), _len(std::strlen(cstr))
+{
+}
+
+StrView StrView::substr(size_t pos, size_t n) const
+{
+	if (pos > _len)
+		pos = _len;
+	if (n > _len - pos)
+		n = _len - pos;
+	return StrView(_data + pos, n);
+}
+
+size_t StrView::find(char c, size_t pos) const
+{
+	if (pos >= _len)
+		return npos;
+	const void* hit = std::memchr(_data + pos, c, _len - pos);
+	if (!hit)
+		return npos;
+	return static_cast<const char*>(hit) - _data;
+}
+
+bool StrView::operator==(const StrView& other) const
+{
+	return _len == other._len && std::memcmp(_data, other._data, _len) == 0;
+}
+
+bool StrView::operator!=(const StrView& other) const
+{
+	return !(*this == other);
+}
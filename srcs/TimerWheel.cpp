@@ -0,0 +1,191 @@
+#include "TimerWheel.hpp"
+
+// Timer
+
+Timer::Timer() : prev(NULL), next(NULL), expires(0), owner(NULL)
+{
+}
+
+Timer::~Timer()
+{
+	cancel();
+}
+
+bool Timer::pending() const
+{
+	return prev != NULL;
+}
+
+void Timer::cancel()
+{
+	if (!prev)
+		return;
+	prev->next = next;
+	next->prev = prev;
+	prev = NULL;
+	next = NULL;
+}
+
+static void linkTail(Timer& head, Timer& t)
+{
+	t.prev = head.prev;
+	t.next = &head;
+	head.prev->next = &t;
+	head.prev = &t;
+}
+
+// Rotates right so that bit `start` lands on bit 0
+static unsigned long long rotate(unsigned long long bits, unsigned start)
+{
+	if (start == 0)
+		return bits;
+	return (bits >> start) | (bits << (64 - start));
+}
+
+// TimerWheel
+
+TimerWheel::TimerWheel(long nowMs, long tickMs)
+	: _originMs(nowMs), _tickMs(tickMs > 0 ? tickMs : 1), _now(0)
+{
+	for (unsigned level = 0; level < kLevels; ++level)
+	{
+		for (unsigned slot = 0; slot < kSlots; ++slot)
+		{
+			_slots[level][slot].prev = &_slots[level][slot];
+			_slots[level][slot].next = &_slots[level][slot];
+		}
+		_occupied[level] = 0;
+	}
+	_expired.prev = &_expired;
+	_expired.next = &_expired;
+}
+
+unsigned long TimerWheel::tickAt(long ms) const
+{
+	if (ms <= _originMs)
+		return 0;
+	return static_cast<unsigned long>(ms - _originMs) / _tickMs;
+}
+
+void TimerWheel::schedule(Timer& t, long dueMs)
+{
+	t.cancel();
+	unsigned long rel = dueMs > _originMs
+		? static_cast<unsigned long>(dueMs - _originMs) : 0;
+	t.expires = (rel + _tickMs - 1) / _tickMs;
+	place(t);
+}
+
+// Level L holds timers due in less than kSlots^(L+1) ticks, in the slot
+// of their L-th group of kBits
+void TimerWheel::place(Timer& t)
+{
+	if (t.expires <= _now)
+	{
+		linkTail(_expired, t);
+		return;
+	}
+
+	static const unsigned long kRange = 1UL << (kBits * kLevels);
+	unsigned long delta = t.expires - _now;
+	if (delta >= kRange)
+	{
+		t.expires = _now + kRange - 1;
+		delta = kRange - 1;
+	}
+	unsigned level = 0;
+	while (delta >= (1UL << (kBits * (level + 1))))
+		++level;
+
+	unsigned slot = (t.expires >> (kBits * level)) & (kSlots - 1);
+	linkTail(_slots[level][slot], t);
+	_occupied[level] |= 1ULL << slot;
+}
+
+// Spreads the current slot of `level` over the levels below
+void TimerWheel::cascade(unsigned level)
+{
+	unsigned slot = (_now >> (kBits * level)) & (kSlots - 1);
+	Timer& head = _slots[level][slot];
+	_occupied[level] &= ~(1ULL << slot);
+
+	while (head.next != &head)
+	{
+		Timer* t = head.next;
+		t->cancel();
+		place(*t);
+	}
+}
+
+void TimerWheel::advance(long nowMs)
+{
+	unsigned long target = tickAt(nowMs);
+	while (_now < target)
+	{
+		bool idle = true;
+		for (unsigned level = 0; level < kLevels; ++level)
+			idle = idle && _occupied[level] == 0;
+		if (idle)
+		{
+			_now = target;
+			break;
+		}
+
+		++_now;
+		for (unsigned level = 1; level < kLevels; ++level)
+		{
+			if ((_now & ((1UL << (kBits * level)) - 1)) != 0)
+				break;
+			cascade(level);
+		}
+
+		unsigned slot = _now & (kSlots - 1);
+		Timer& head = _slots[0][slot];
+		_occupied[0] &= ~(1ULL << slot);
+		while (head.next != &head)
+		{
+			Timer* t = head.next;
+			t->cancel();
+			linkTail(_expired, *t);
+		}
+	}
+}
+
+Timer* TimerWheel::popExpired()
+{
+	if (_expired.next == &_expired)
+		return NULL;
+	Timer* t = _expired.next;
+	t->cancel();
+	return t;
+}
+
+// Earliest tick at which some slot runs or cascades. Stale occupancy bits
+// only make the wait shorter.
+long TimerWheel::nextTimeout(long nowMs) const
+{
+	if (_expired.next != &_expired)
+		return 0;
+
+	bool found = false;
+	unsigned long best = 0;
+	for (unsigned level = 0; level < kLevels; ++level)
+	{
+		if (_occupied[level] == 0)
+			continue;
+		unsigned shift = kBits * level;
+		unsigned long first = ((_now >> shift) + 1) << shift;
+		unsigned start = (first >> shift) & (kSlots - 1);
+		unsigned long long bits = rotate(_occupied[level], start);
+		unsigned long tick = first
+			+ (static_cast<unsigned long>(__builtin_ctzll(bits)) << shift);
+		if (!found || tick < best)
+			best = tick;
+		found = true;
+	}
+	if (!found)
+		return -1;
+
+	long wait = _originMs + static_cast<long>(best) * _tickMs - nowMs;
+	return wait > 0 ? wait : 0;
+}
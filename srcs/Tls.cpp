@@ -0,0 +1,258 @@
+#include "Tls.hpp"
+#include "OutQueue.hpp"
+#include "RecvRing.hpp"
+
+#ifdef IRC_TLS
+
+# include <openssl/ssl.h>
+# include <openssl/err.h>
+# include <cstring>
+
+// Plaintext handed to one SSL_write: a full record
+static const size_t kRecord = 16384;
+// Encrypted per write() call, so one fast reader cannot hold the loop for
+// long; much less and a busy receiver's queue outgrows --sendq-max
+static const size_t kWriteBudget = 16 * kRecord;
+
+static std::string lastError()
+{
+	unsigned long code = ERR_get_error();
+	if (!code)
+		return "unknown error";
+	char buf[256];
+	ERR_error_string_n(code, buf, sizeof(buf));
+	ERR_clear_error();
+	return buf;
+}
+
+// TlsContext
+
+TlsContext::TlsContext() : _ctx(NULL)
+{
+}
+
+TlsContext::~TlsContext()
+{
+	if (_ctx)
+		SSL_CTX_free(_ctx);
+}
+
+bool TlsContext::available()
+{
+	return true;
+}
+
+bool TlsContext::load(const std::string& certFile, const std::string& keyFile,
+	std::string& error)
+{
+	_ctx = SSL_CTX_new(TLS_server_method());
+	if (!_ctx)
+	{
+		error = lastError();
+		return false;
+	}
+	SSL_CTX_set_min_proto_version(_ctx, TLS1_2_VERSION);
+	SSL_CTX_set_options(_ctx, SSL_OP_NO_RENEGOTIATION);
+	// Partial writes and a moving buffer let a retry start from whatever
+	// the queue holds now; idle connections give their buffers back
+	SSL_CTX_set_mode(_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE
+		| SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+# ifdef SSL_OP_ENABLE_KTLS
+	SSL_CTX_set_options(_ctx, SSL_OP_ENABLE_KTLS);
+# endif
+
+	if (SSL_CTX_use_certificate_chain_file(_ctx, certFile.c_str()) != 1)
+	{
+		error = certFile + ": " + lastError();
+		return false;
+	}
+	if (SSL_CTX_use_PrivateKey_file(_ctx, keyFile.c_str(), SSL_FILETYPE_PEM) != 1
+		|| SSL_CTX_check_private_key(_ctx) != 1)
+	{
+		error = keyFile + ": " + lastError();
+		return false;
+	}
+	return true;
+}
+
+ssl_ctx_st* TlsContext::handle() const
+{
+	return _ctx;
+}
+
+// TlsStream
+
+TlsStream::TlsStream(const TlsContext& ctx, int fd)
+	: _ssl(SSL_new(ctx.handle())), _established(false), _wantWrite(false)
+{
+	if (_ssl && SSL_set_fd(_ssl, fd) != 1)
+	{
+		SSL_free(_ssl);
+		_ssl = NULL;
+	}
+	if (_ssl)
+		SSL_set_accept_state(_ssl);
+}
+
+TlsStream::~TlsStream()
+{
+	if (_ssl)
+		SSL_free(_ssl);
+}
+
+bool TlsStream::valid() const { return _ssl != NULL; }
+bool TlsStream::established() const { return _established; }
+bool TlsStream::wantsWrite() const { return _wantWrite; }
+
+TlsStream::Status TlsStream::handshake()
+{
+	ERR_clear_error();
+	int rc = SSL_do_handshake(_ssl);
+	if (rc == 1)
+	{
+		_established = true;
+		_wantWrite = false;
+		return TLS_DONE;
+	}
+	int err = SSL_get_error(_ssl, rc);
+	if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+	{
+		_wantWrite = (err == SSL_ERROR_WANT_WRITE);
+		return TLS_AGAIN;
+	}
+	ERR_clear_error();
+	return TLS_FAILED;
+}
+
+bool TlsStream::offloaded() const
+{
+	return _established && SSL_pending(_ssl) == 0
+		&& BIO_get_ktls_send(SSL_get_wbio(_ssl))
+		&& BIO_get_ktls_recv(SSL_get_rbio(_ssl));
+}
+
+ssize_t TlsStream::read(RecvRing& ring)
+{
+	char buf[4096];
+	ssize_t total = 0;
+
+	_wantWrite = false;
+	while (!ring.full())
+	{
+		size_t room = RecvRing::kMax - ring.pending();
+		if (room > sizeof(buf))
+			room = sizeof(buf);
+		ERR_clear_error();
+		int n = SSL_read(_ssl, buf, static_cast<int>(room));
+		if (n > 0)
+		{
+			if (!ring.append(buf, n))
+				return -1;
+			total += n;
+			continue;
+		}
+		int err = SSL_get_error(_ssl, n);
+		if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+		{
+			_wantWrite = (err == SSL_ERROR_WANT_WRITE);
+			return total;
+		}
+		// close_notify, a reset or a bad record; whatever came first
+		// still gets processed
+		ERR_clear_error();
+		return total ? total : -1;
+	}
+	return total ? total : -1;
+}
+
+bool TlsStream::buffered() const
+{
+	return SSL_pending(_ssl) > 0;
+}
+
+// Queued chunks are packed into full records rather than sealed one by
+// one, since most are single short lines
+ssize_t TlsStream::write(OutQueue& out)
+{
+	ssize_t total = 0;
+	char record[kRecord];
+
+	_wantWrite = false;
+	while (!out.empty() && static_cast<size_t>(total) < kWriteBudget)
+	{
+		struct iovec iov[64];
+		size_t count = out.gather(iov, 64);
+		size_t len = 0;
+		for (size_t i = 0; i < count && len < kRecord; ++i)
+		{
+			size_t take = iov[i].iov_len;
+			if (take > kRecord - len)
+				take = kRecord - len;
+			std::memcpy(record + len, iov[i].iov_base, take);
+			len += take;
+		}
+
+		ERR_clear_error();
+		int n = SSL_write(_ssl, record, static_cast<int>(len));
+		if (n > 0)
+		{
+			out.consume(n);
+			total += n;
+			continue;
+		}
+		int err = SSL_get_error(_ssl, n);
+		if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ)
+		{
+			_wantWrite = (err == SSL_ERROR_WANT_WRITE);
+			return total;
+		}
+		ERR_clear_error();
+		return -1;
+	}
+	return total;
+}
+
+void TlsStream::close()
+{
+	if (_established)
+		SSL_shutdown(_ssl);
+	ERR_clear_error();
+}
+
+std::string TlsStream::describe() const
+{
+	return std::string(SSL_get_version(_ssl)) + " " + SSL_get_cipher_name(_ssl);
+}
+
+#else
+
+// Built without OpenSSL: the listener is refused at startup, so nothing
+// below is ever reached
+
+TlsContext::TlsContext() : _ctx(NULL) {}
+TlsContext::~TlsContext() {}
+bool TlsContext::available() { return false; }
+
+bool TlsContext::load(const std::string&, const std::string&, std::string& error)
+{
+	error = "built without OpenSSL";
+	return false;
+}
+
+ssl_ctx_st* TlsContext::handle() const { return _ctx; }
+
+TlsStream::TlsStream(const TlsContext&, int)
+	: _ssl(NULL), _established(false), _wantWrite(false) {}
+TlsStream::~TlsStream() {}
+bool TlsStream::valid() const { return false; }
+TlsStream::Status TlsStream::handshake() { return TLS_FAILED; }
+bool TlsStream::established() const { return false; }
+bool TlsStream::wantsWrite() const { return false; }
+bool TlsStream::offloaded() const { return false; }
+ssize_t TlsStream::read(RecvRing&) { return -1; }
+bool TlsStream::buffered() const { return false; }
+ssize_t TlsStream::write(OutQueue&) { return -1; }
+void TlsStream::close() {}
+std::string TlsStream::describe() const { return "none"; }
+
+#endif
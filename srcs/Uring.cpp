@@ -0,0 +1,340 @@
+#include "Uring.hpp"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+
+#ifdef __linux__
+# include <sys/mman.h>
+# include <sys/syscall.h>
+
+// Ring indices are shared with the kernel: loads of its side need acquire,
+// stores of ours need release ordering
+static unsigned loadAcquire(const unsigned* p)
+{
+	unsigned v = *static_cast<const volatile unsigned*>(p);
+	__sync_synchronize();
+	return v;
+}
+
+static void storeRelease(unsigned* p, unsigned v)
+{
+	__sync_synchronize();
+	*static_cast<volatile unsigned*>(p) = v;
+}
+
+Uring::Uring()
+	: _fd(-1), _sqMap(NULL), _sqMapLen(0), _cqMap(NULL), _cqMapLen(0),
+	  _sqeMap(NULL), _sqeMapLen(0), _sqHead(NULL), _sqTail(NULL), _sqMask(0),
+	  _sqEntries(0), _sqArray(NULL), _sqLocalTail(0), _toSubmit(0),
+	  _cqHead(NULL), _cqTail(NULL), _cqMask(0), _cqes(NULL),
+	  _bufRing(NULL), _bufRingLen(0), _bufData(NULL), _bufCount(0),
+	  _bufSize(0), _bufTail(0)
+{
+}
+
+Uring::~Uring()
+{
+	// Closing the ring cancels whatever is still in flight
+	if (_fd >= 0)
+		close(_fd);
+	if (_sqeMap)
+		munmap(_sqeMap, _sqeMapLen);
+	if (_cqMap && _cqMap != _sqMap)
+		munmap(_cqMap, _cqMapLen);
+	if (_sqMap)
+		munmap(_sqMap, _sqMapLen);
+	if (_bufRing)
+		munmap(_bufRing, _bufRingLen);
+	delete[] _bufData;
+}
+
+bool Uring::init(unsigned entries, unsigned bufCount, unsigned bufSize)
+{
+	return setupRings(entries) && setupBuffers(bufCount, bufSize);
+}
+
+bool Uring::setupRings(unsigned entries)
+{
+	struct io_uring_params p;
+	std::memset(&p, 0, sizeof(p));
+	// Multishot requests post many completions per submission
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = entries * 4;
+
+	_fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (_fd < 0)
+		return false;
+
+	unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP
+		| IORING_FEAT_EXT_ARG;
+	if ((p.features & needed) != needed)
+		return false;
+
+	_sqMapLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	_cqMapLen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (_cqMapLen > _sqMapLen)
+		_sqMapLen = _cqMapLen;
+
+	_sqMap = mmap(NULL, _sqMapLen, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+	if (_sqMap == MAP_FAILED)
+	{
+		_sqMap = NULL;
+		return false;
+	}
+	_cqMap = _sqMap;
+	_cqMapLen = _sqMapLen;
+
+	_sqeMapLen = p.sq_entries * sizeof(struct io_uring_sqe);
+	_sqeMap = mmap(NULL, _sqeMapLen, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+	if (_sqeMap == MAP_FAILED)
+	{
+		_sqeMap = NULL;
+		return false;
+	}
+
+	char* sq = static_cast<char*>(_sqMap);
+	_sqHead = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+	_sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+	_sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+	_sqEntries = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_entries);
+	_sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+	_sqLocalTail = *_sqTail;
+
+	char* cq = static_cast<char*>(_cqMap);
+	_cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+	_cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+	_cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+	_cqes = cq + p.cq_off.cqes;
+	return true;
+}
+
+bool Uring::setupBuffers(unsigned count, unsigned size)
+{
+	if (count == 0 || (count & (count - 1)) || count > 32768)
+		return false;
+
+	// The ring must be page aligned, which an anonymous mapping is
+	_bufRingLen = count * sizeof(struct io_uring_buf);
+	_bufRing = mmap(NULL, _bufRingLen, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (_bufRing == MAP_FAILED)
+	{
+		_bufRing = NULL;
+		return false;
+	}
+
+	struct io_uring_buf_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = reinterpret_cast<uintptr_t>(_bufRing);
+	reg.ring_entries = count;
+	reg.bgid = 0;
+	if (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+		return false;
+
+	_bufCount = count;
+	_bufSize = size;
+	_bufData = new char[static_cast<size_t>(count) * size];
+	for (unsigned i = 0; i < count; ++i)
+		provide(static_cast<unsigned short>(i));
+	return true;
+}
+
+// Hands buffer `bid` back to the kernel. The ring is indexed as a plain
+// io_uring_buf array: in C++ the header's flex-array wrapper shifts
+// `bufs` by one byte of empty struct. The tail overlays bufs[0].resv.
+void Uring::provide(unsigned short bid)
+{
+	struct io_uring_buf* ring = static_cast<struct io_uring_buf*>(_bufRing);
+	struct io_uring_buf* buf = &ring[_bufTail & (_bufCount - 1)];
+	buf->addr = reinterpret_cast<uintptr_t>(_bufData + static_cast<size_t>(bid) * _bufSize);
+	buf->len = _bufSize;
+	buf->bid = bid;
+	++_bufTail;
+	__sync_synchronize();
+	*static_cast<volatile unsigned short*>(&ring[0].resv) = _bufTail;
+}
+
+void Uring::publish()
+{
+	storeRelease(_sqTail, _sqLocalTail);
+}
+
+// Next free submission slot, zeroed; a full ring is submitted first
+void* Uring::nextSqe()
+{
+	if (_sqLocalTail - loadAcquire(_sqHead) >= _sqEntries)
+	{
+		publish();
+		int n = syscall(__NR_io_uring_enter, _fd, _toSubmit, 0, 0, NULL, 0);
+		if (n > 0)
+			_toSubmit -= (static_cast<unsigned>(n) < _toSubmit) ? n : _toSubmit;
+		if (_sqLocalTail - loadAcquire(_sqHead) >= _sqEntries)
+			return NULL;
+	}
+
+	unsigned idx = _sqLocalTail & _sqMask;
+	struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(_sqeMap) + idx;
+	std::memset(sqe, 0, sizeof(*sqe));
+	_sqArray[idx] = idx;
+	++_sqLocalTail;
+	++_toSubmit;
+	return sqe;
+}
+
+bool Uring::acceptMultishot(int listenFd, uint64_t tag)
+{
+	struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(nextSqe());
+	if (!sqe)
+		return false;
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = listenFd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	sqe->user_data = tag;
+	return true;
+}
+
+bool Uring::recv(int fd, uint64_t tag)
+{
+	struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(nextSqe());
+	if (!sqe)
+		return false;
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+	sqe->user_data = tag;
+	return true;
+}
+
+bool Uring::sendmsg(int fd, const struct msghdr* msg, uint64_t tag)
+{
+	struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(nextSqe());
+	if (!sqe)
+		return false;
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<uintptr_t>(msg);
+	sqe->len = 1;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = tag;
+	return true;
+}
+
+bool Uring::pollIn(int fd, uint64_t tag)
+{
+	struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(nextSqe());
+	if (!sqe)
+		return false;
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = POLLIN;
+	sqe->user_data = tag;
+	return true;
+}
+
+bool Uring::cancel(uint64_t target, uint64_t tag)
+{
+	struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(nextSqe());
+	if (!sqe)
+		return false;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = target;
+	sqe->user_data = tag;
+	return true;
+}
+
+int Uring::submitAndWait(int timeoutMs)
+{
+	publish();
+
+	// Completions already waiting: submit without blocking
+	unsigned waitFor = (loadAcquire(_cqTail) != *_cqHead) ? 0 : 1;
+	unsigned flags = IORING_ENTER_GETEVENTS;
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	void* argp = NULL;
+	size_t argLen = 0;
+
+	if (timeoutMs >= 0)
+	{
+		ts.tv_sec = timeoutMs / 1000;
+		ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+		std::memset(&arg, 0, sizeof(arg));
+		arg.ts = reinterpret_cast<uintptr_t>(&ts);
+		flags |= IORING_ENTER_EXT_ARG;
+		argp = &arg;
+		argLen = sizeof(arg);
+	}
+
+	int n = syscall(__NR_io_uring_enter, _fd, _toSubmit, waitFor, flags, argp, argLen);
+	if (n < 0)
+		return -errno;
+	_toSubmit -= (static_cast<unsigned>(n) < _toSubmit) ? n : _toSubmit;
+	return 0;
+}
+
+bool Uring::next(UringCompletion& out)
+{
+	unsigned head = *_cqHead;
+	if (head == loadAcquire(_cqTail))
+		return false;
+
+	const struct io_uring_cqe* cqe =
+		static_cast<const struct io_uring_cqe*>(_cqes) + (head & _cqMask);
+	out.tag = cqe->user_data;
+	out.res = cqe->res;
+	out.flags = cqe->flags;
+	storeRelease(_cqHead, head + 1);
+	return true;
+}
+
+const char* Uring::buffer(const UringCompletion& c) const
+{
+	if (!(c.flags & IORING_CQE_F_BUFFER))
+		return NULL;
+	size_t bid = c.flags >> IORING_CQE_BUFFER_SHIFT;
+	return _bufData + bid * _bufSize;
+}
+
+void Uring::recycle(const UringCompletion& c)
+{
+	if (c.flags & IORING_CQE_F_BUFFER)
+		provide(static_cast<unsigned short>(c.flags >> IORING_CQE_BUFFER_SHIFT));
+}
+
+#else
+
+// Not Linux: init() fails and the server refuses --io uring
+Uring::Uring()
+	: _fd(-1), _sqMap(NULL), _sqMapLen(0), _cqMap(NULL), _cqMapLen(0),
+	  _sqeMap(NULL), _sqeMapLen(0), _sqHead(NULL), _sqTail(NULL), _sqMask(0),
+	  _sqEntries(0), _sqArray(NULL), _sqLocalTail(0), _toSubmit(0),
+	  _cqHead(NULL), _cqTail(NULL), _cqMask(0), _cqes(NULL),
+	  _bufRing(NULL), _bufRingLen(0), _bufData(NULL), _bufCount(0),
+	  _bufSize(0), _bufTail(0)
+{
+}
+
+Uring::~Uring() {}
+bool Uring::init(unsigned, unsigned, unsigned) { return false; }
+bool Uring::setupRings(unsigned) { return false; }
+bool Uring::setupBuffers(unsigned, unsigned) { return false; }
+void* Uring::nextSqe() { return NULL; }
+void Uring::publish() {}
+void Uring::provide(unsigned short) {}
+bool Uring::acceptMultishot(int, uint64_t) { return false; }
+bool Uring::recv(int, uint64_t) { return false; }
+bool Uring::sendmsg(int, const struct msghdr*, uint64_t) { return false; }
+bool Uring::pollIn(int, uint64_t) { return false; }
+bool Uring::cancel(uint64_t, uint64_t) { return false; }
+int Uring::submitAndWait(int) { return -ENOSYS; }
+bool Uring::next(UringCompletion&) { return false; }
+const char* Uring::buffer(const UringCompletion&) const { return NULL; }
+void Uring::recycle(const UringCompletion&) {}
+
+#endif
@@ -1,43 +1,16 @@
 #include "IRCCore.hpp"
-#include <iostream>
+#include "Logger.hpp"
 #include <cstdlib>
 #include <sstream>
 
-void IRCCore::cmdKick(Session& sess, const std::string& args)
+void IRCCore::cmdKick(Session& sess, const IrcMessage& msg)
 {
-	if (args.empty())
-	{
-		replyNumeric(sess, "461", "KICK :Not enough parameters");
-		return;
-	}
-
-	std::string rest = args;
-	std::string chanGroup = "";
-	size_t sp = rest.find(' ');
-	if (sp != std::string::npos)
-	{
-		chanGroup = rest.substr(0, sp);
-		rest = rest.substr(sp + 1);
-	}
-	else
-	{
-		replyNumeric(sess, "461", "KICK :Not enough parameters");
-		return;
-	}
-
-	std::string nickGroup = rest;
 	std::string reason = sess.getNick();
-	sp = rest.find(' ');
-	if (sp != std::string::npos)
-	{
-		nickGroup = rest.substr(0, sp);
-		reason = rest.substr(sp + 1);
-		if (!reason.empty() && reason[0] == ':')
-			reason = reason.substr(1);
-	}
+	if (msg.paramCount > 2)
+		reason = msg.rest(2).str();
 
-	std::vector<std::string> chans = splitComma(chanGroup);
-	std::vector<std::string> nicks = splitComma(nickGroup);
+	std::vector<std::string> chans = splitComma(msg.params[0]);
+	std::vector<std::string> nicks = splitComma(msg.params[1]);
 
 	for (size_t i = 0; i < chans.size(); ++i)
 	{
@@ -71,32 +44,20 @@ void IRCCore::cmdKick(Session& sess, const std::string& args)
 				_rooms.erase(chans[i]);
 				delete room;
 				room = NULL;
-				std::cout << "[CHANNEL] Deleted: " << chans[i] << std::endl;
+				Log(LOG_INFO) << "[CHANNEL] Deleted: " << chans[i];
 				break;
 			}
 
-			std::cout << "[KICK] " << sess.getNick() << " kicked "
-				<< nicks[j] << " from " << chans[i] << std::endl;
+			Log(LOG_INFO) << "[KICK] " << sess.getNick() << " kicked "
+				<< nicks[j] << " from " << chans[i];
 		}
 	}
 }
 
-void IRCCore::cmdInvite(Session& sess, const std::string& args)
+void IRCCore::cmdInvite(Session& sess, const IrcMessage& msg)
 {
-	std::string nick = args;
-	std::string roomLabel = "";
-	size_t sp = args.find(' ');
-	if (sp != std::string::npos)
-	{
-		nick = args.substr(0, sp);
-		roomLabel = args.substr(sp + 1);
-	}
-
-	if (nick.empty() || roomLabel.empty())
-	{
-		replyNumeric(sess, "461", "INVITE :Not enough parameters");
-		return;
-	}
+	std::string nick = msg.params[0].str();
+	std::string roomLabel = msg.params[1].str();
 
 	Room* room = requireRoom(sess, roomLabel, true);
 	if (!room)
@@ -123,30 +84,15 @@ void IRCCore::cmdInvite(Session& sess, const std::string& args)
 		+ nick + " " + roomLabel + "\r\n";
 	enqueueReply(*dest, invLine);
 
-	std::cout << "[INVITE] " << sess.getNick() << " invited "
-		<< nick << " to " << roomLabel << std::endl;
+	Log(LOG_INFO) << "[INVITE] " << sess.getNick() << " invited "
+		<< nick << " to " << roomLabel;
 }
 
-void IRCCore::cmdTopic(Session& sess, const std::string& args)
+void IRCCore::cmdTopic(Session& sess, const IrcMessage& msg)
 {
-	if (args.empty())
-	{
-		replyNumeric(sess, "461", "TOPIC :Not enough parameters");
-		return;
-	}
-
-	std::string roomLabel = args;
-	std::string newSubject = "";
-	bool hasSubject = false;
-	size_t sp = args.find(' ');
-	if (sp != std::string::npos)
-	{
-		roomLabel = args.substr(0, sp);
-		newSubject = args.substr(sp + 1);
-		hasSubject = true;
-		if (!newSubject.empty() && newSubject[0] == ':')
-			newSubject = newSubject.substr(1);
-	}
+	std::string roomLabel = msg.params[0].str();
+	bool hasSubject = (msg.paramCount > 1);
+	std::string newSubject = msg.rest(1).str();
 
 	Room* room = requireRoom(sess, roomLabel, false);
 	if (!room)
@@ -175,8 +121,8 @@ void IRCCore::cmdTopic(Session& sess, const std::string& args)
 			+ roomLabel + " :" + newSubject + "\r\n";
 		room->relayAll(topicLine);
 
-		std::cout << "[TOPIC] " << sess.getNick() << " set topic of "
-			<< roomLabel << " to: " << newSubject << std::endl;
+		Log(LOG_INFO) << "[TOPIC] " << sess.getNick() << " set topic of "
+			<< roomLabel << " to: " << newSubject;
 	}
 }
 
@@ -209,16 +155,16 @@ void IRCCore::showChannelModes(Session& sess, const std::string& target)
 	replyNumeric(sess, "324", target + " " + flags + extra);
 }
 
-void IRCCore::applyChannelModes(Session& sess, const std::string& target, 
-	const std::string& modeStr, 
-	const std::vector<std::string>& modeArgs)
+void IRCCore::applyChannelModes(Session& sess, const std::string& target,
+	const IrcMessage& msg)
 {
+	StrView modeStr = msg.params[1];
 	Room* room = requireRoom(sess, target, true);
 	if (!room)
 		return;
 
 	bool adding = true;
-	size_t argIdx = 0;
+	size_t argIdx = 2;
 	std::string applied = "";
 	std::string appliedArgs = "";
 	bool anyValid = false;
@@ -262,13 +208,13 @@ void IRCCore::applyChannelModes(Session& sess, const std::string& target,
 			{
 				if (adding)
 				{
-					if (argIdx >= modeArgs.size())
+					if (argIdx >= msg.paramCount)
 					{
 						replyNumeric(sess, "461",
 							"MODE +k :Not enough parameters");
 						continue;
 					}
-					std::string key = modeArgs[argIdx++];
+					std::string key = msg.params[argIdx++].str();
 					room->changePassphrase(key);
 					applied += 'k';
 					appliedArgs += " " + key;
@@ -284,14 +230,14 @@ void IRCCore::applyChannelModes(Session& sess, const std::string& target,
 
 			case 'o':
 			{
-				if (argIdx >= modeArgs.size())
+				if (argIdx >= msg.paramCount)
 				{
 					replyNumeric(sess, "461",
 						"MODE +o :Not enough parameters");
 					continue;
 				}
 
-				std::string who = modeArgs[argIdx++];
+				std::string who = msg.params[argIdx++].str();
 				Session* tgt = locateByNick(who);
 
 				if (!tgt)
@@ -323,14 +269,14 @@ void IRCCore::applyChannelModes(Session& sess, const std::string& target,
 			{
 				if (adding)
 				{
-					if (argIdx >= modeArgs.size())
+					if (argIdx >= msg.paramCount)
 					{
 						replyNumeric(sess, "461",
 							"MODE +l :Not enough parameters");
 						continue;
 					}
 
-					std::string limStr = modeArgs[argIdx++];
+					std::string limStr = msg.params[argIdx++].str();
 					int lim = std::atoi(limStr.c_str());
 
 					if (lim <= 0)
@@ -365,38 +311,25 @@ void IRCCore::applyChannelModes(Session& sess, const std::string& target,
 		std::string modeLine = buildPrefix(sess) + " MODE " + target
 			+ " " + applied + appliedArgs + "\r\n";
 		room->relayAll(modeLine);
-		std::cout << "[MODE] " << sess.getNick() << " set mode "
-			<< applied << appliedArgs << " on " << target << std::endl;
+		Log(LOG_INFO) << "[MODE] " << sess.getNick() << " set mode "
+			<< applied << appliedArgs << " on " << target;
 	}
 }
 
-void IRCCore::cmdMode(Session& sess, const std::string& args)
+void IRCCore::cmdMode(Session& sess, const IrcMessage& msg)
 {
-	std::istringstream iss(args);
-	std::string target;
-	std::string modeStr;
-
-	if (!(iss >> target))
-	{
-		replyNumeric(sess, "461", "MODE :Not enough parameters");
-		return;
-	}
+	std::string target = msg.params[0].str();
 
 	if (target[0] != '#')
 	{
 		return;
 	}
 
-	if (!(iss >> modeStr))
+	if (msg.paramCount < 2 || msg.params[1].empty())
 	{
 		showChannelModes(sess, target);
 		return;
 	}
 
-	std::vector<std::string> modeArgs;
-	std::string tok;
-	while (iss >> tok)
-		modeArgs.push_back(tok);
-
-	applyChannelModes(sess, target, modeStr, modeArgs);
+	applyChannelModes(sess, target, msg);
 }
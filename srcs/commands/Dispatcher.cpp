@@ -1,50 +1,178 @@
 #include "IRCCore.hpp"
-#include <iostream>
+#include "Logger.hpp"
+#include <cctype>
 
-void IRCCore::dispatch(Session& sess, const std::string& line)
+// Indices into _commands, used by the lookup switch below
+enum {
+	C_PASS, C_NICK, C_USER, C_QUIT,
+	C_JOIN, C_PART, C_PRIVMSG, C_KICK, C_INVITE, C_TOPIC, C_MODE,
+	C_PING, C_PONG, C_NAMES, C_LIST, C_USERHOST, C_WHO, C_WHOIS, C_OPER, C_STATS
+};
+
+// name, handler (NULL = accepted and ignored), min params,
+// registration required, flood cost
+const IRCCore::CommandSpec IRCCore::_commands[] = {
+	{ "PASS",     &IRCCore::cmdPass,    1, false, 1 },
+	{ "NICK",     &IRCCore::cmdNick,    0, false, 2 },
+	{ "USER",     &IRCCore::cmdUser,    3, false, 1 },
+	{ "QUIT",     &IRCCore::cmdQuit,    0, false, 1 },
+	{ "JOIN",     &IRCCore::cmdJoin,    1, true,  3 },
+	{ "PART",     &IRCCore::cmdPart,    1, true,  2 },
+	{ "PRIVMSG",  &IRCCore::cmdPrivmsg, 0, true,  2 },
+	{ "KICK",     &IRCCore::cmdKick,    2, true,  2 },
+	{ "INVITE",   &IRCCore::cmdInvite,  2, true,  2 },
+	{ "TOPIC",    &IRCCore::cmdTopic,   1, true,  2 },
+	{ "MODE",     &IRCCore::cmdMode,    1, true,  2 },
+	{ "PING",     &IRCCore::cmdPing,    0, true,  1 },
+	{ "PONG",     &IRCCore::cmdPong,    0, false, 1 },
+	{ "NAMES",    &IRCCore::cmdNames,   1, true,  5 },
+	{ "LIST",     &IRCCore::cmdList,    0, true,  10 },
+	{ "USERHOST", NULL,                 0, true,  1 },
+	{ "WHO",      NULL,                 0, true,  1 },
+	{ "WHOIS",    NULL,                 0, true,  1 },
+	{ "OPER",     &IRCCore::cmdOper,    2, true,  2 },
+	{ "STATS",    &IRCCore::cmdStats,   0, true,  5 }
+};
+const size_t IRCCore::_commandCount = sizeof(_commands) / sizeof(_commands[0]);
+
+static char up(const StrView& v, size_t i)
+{
+	return std::toupper(static_cast<unsigned char>(v[i]));
+}
+
+// Constant-time lookup: length and one or two characters pick at most
+// one candidate, which is then confirmed with a single comparison.
+const IRCCore::CommandSpec* IRCCore::findCommand(const IrcMessage& msg)
+{
+	const StrView& v = msg.command;
+	int idx = -1;
+
+	switch (v.size())
+	{
+		case 3:
+			idx = C_WHO;
+			break;
+		case 4:
+			switch (up(v, 0))
+			{
+				case 'P':
+					idx = (up(v, 2) == 'S') ? C_PASS
+						: (up(v, 2) == 'R') ? C_PART
+						: (up(v, 1) == 'O') ? C_PONG : C_PING;
+					break;
+				case 'N': idx = C_NICK; break;
+				case 'U': idx = C_USER; break;
+				case 'Q': idx = C_QUIT; break;
+				case 'J': idx = C_JOIN; break;
+				case 'K': idx = C_KICK; break;
+				case 'M': idx = C_MODE; break;
+				case 'L': idx = C_LIST; break;
+				case 'O': idx = C_OPER; break;
+			}
+			break;
+		case 5:
+			switch (up(v, 0))
+			{
+				case 'N': idx = C_NAMES; break;
+				case 'T': idx = C_TOPIC; break;
+				case 'S': idx = C_STATS; break;
+				case 'W': idx = C_WHOIS; break;
+			}
+			break;
+		case 6:
+			idx = C_INVITE;
+			break;
+		case 7:
+			idx = C_PRIVMSG;
+			break;
+		case 8:
+			idx = C_USERHOST;
+			break;
+	}
+
+	if (idx < 0 || !msg.is(_commands[idx].name))
+		return NULL;
+	return &_commands[idx];
+}
+
+void IRCCore::dispatch(Session& sess, const StrView& line)
 {
-	std::cout << "[COMMAND] FD " << sess.getSocket() << ": " << line << std::endl;
+	Log(LOG_DEBUG) << "[COMMAND] FD " << sess.getSocket() << ": " << line;
 
-	std::string verb = parseVerb(line);
-	std::string args = parseArgs(line);
+	IrcMessage msg;
+	if (!parseMessage(line, msg))
+		return;
+	_metrics.linesIn.add();
 
-	if (verb == "PASS")
-		return cmdPass(sess, args);
-	if (verb == "NICK")
-		return cmdNick(sess, args);
-	if (verb == "USER")
-		return cmdUser(sess, args);
-	if (verb == "QUIT")
-		return cmdQuit(sess, args);
+	const CommandSpec* cmd = findCommand(msg);
+	chargeFlood(sess, cmd ? cmd->floodCost : 1);
+	// Keepalive traffic does not count against --idle-timeout
+	if (cmd != &_commands[C_PING] && cmd != &_commands[C_PONG])
+		sess.setLastActive(_clockMs);
 
-	if (!sess.isWelcomed())
+	if ((!cmd || cmd->needsRegistration) && !sess.isWelcomed())
 	{
 		replyNumeric(sess, "451", ":You have not registered");
 		return;
 	}
+	if (!cmd)
+	{
+		replyNumeric(sess, "421", msg.verb() + " :Unknown command");
+		return;
+	}
 
-	if (verb == "JOIN")
-		cmdJoin(sess, args);
-	else if (verb == "PART")
-		cmdPart(sess, args);
-	else if (verb == "PRIVMSG")
-		cmdPrivmsg(sess, args);
-	else if (verb == "KICK")
-		cmdKick(sess, args);
-	else if (verb == "INVITE")
-		cmdInvite(sess, args);
-	else if (verb == "TOPIC")
-		cmdTopic(sess, args);
-	else if (verb == "MODE")
-		cmdMode(sess, args);
-	else if (verb == "PING")
-		cmdPing(sess, args);
-	else if (verb == "NAMES")
-		cmdNames(sess, args);
-	else if (verb == "LIST")
-		cmdList(sess, args);
-	else if (verb == "USERHOST" || verb == "WHO" || verb == "WHOIS")
-        ;
+	// Only a trailing parameter can be empty, and it is always the last one
+	if (msg.paramCount < cmd->minParams
+		|| (cmd->minParams && msg.paramCount == cmd->minParams
+			&& msg.params[cmd->minParams - 1].empty()))
+	{
+		replyNumeric(sess, "461", std::string(cmd->name) + " :Not enough parameters");
+		return;
+	}
+
+	if (!cmd->handler)
+		return;
+	if (_timing)
+		timeHandler(sess, msg, cmd);
 	else
-		replyNumeric(sess, "421", verb + " :Unknown command");
+		(this->*cmd->handler)(sess, msg);
+}
+
+IRCCore::CommandTiming::CommandTiming() : fanout(0)
+{
+}
+
+// The handler may drop the session (QUIT, SendQ), so nothing of it is
+// read afterwards
+void IRCCore::timeHandler(Session& sess, const IrcMessage& msg,
+	const CommandSpec* cmd)
+{
+	unsigned long fanout = _metrics.fanout.value();
+	unsigned long long start = monotonicNs();
+	(this->*cmd->handler)(sess, msg);
+	CommandTiming& t = _commandTiming[cmd - _commands];
+	t.latency.record(monotonicNs() - start);
+	t.fanout += _metrics.fanout.value() - fanout;
+}
+
+// Token bucket kept as the time it runs dry (GCRA): a client may run
+// commands while that time is not in the future, so one expensive
+// command can overdraw and the debt delays whatever follows it.
+bool IRCCore::floodAllows(const Session& sess) const
+{
+	return _config.flood.rate == 0 || sess.getFloodClock() <= _clockMs;
+}
+
+void IRCCore::chargeFlood(Session& sess, unsigned int cost)
+{
+	const FloodLimits& lim = _config.flood;
+	if (lim.rate == 0)
+		return;
+
+	// An idle client banks at most `burst` tokens
+	long full = _clockMs - static_cast<long>(lim.burst) * 1000 / lim.rate;
+	long clock = sess.getFloodClock();
+	if (clock < full)
+		clock = full;
+	sess.setFloodClock(clock + static_cast<long>(cost) * 1000 / lim.rate);
 }
@@ -1,23 +1,14 @@
 #include "IRCCore.hpp"
 
-void IRCCore::cmdPrivmsg(Session& sess, const std::string& args)
+void IRCCore::cmdPrivmsg(Session& sess, const IrcMessage& msg)
 {
-	if (args.empty())
+	if (msg.paramCount == 0)
 	{
 		replyNumeric(sess, "411", ":No recipient given (PRIVMSG)");
 		return;
 	}
 
-	std::string targetGroup = args;
-	std::string body = "";
-	size_t sp = args.find(' ');
-	if (sp != std::string::npos)
-	{
-		targetGroup = args.substr(0, sp);
-		body = args.substr(sp + 1);
-		if (!body.empty() && body[0] == ':')
-			body = body.substr(1);
-	}
+	std::string body = msg.rest(1).str();
 
 	if (body.empty())
 	{
@@ -25,7 +16,7 @@ void IRCCore::cmdPrivmsg(Session& sess, const std::string& args)
 		return;
 	}
 
-	std::vector<std::string> targets = splitComma(targetGroup);
+	std::vector<std::string> targets = splitComma(msg.params[0]);
 
 	for (size_t i = 0; i < targets.size(); ++i)
 	{
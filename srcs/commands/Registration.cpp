@@ -1,33 +1,27 @@
 #include "IRCCore.hpp"
-#include <iostream>
+#include "Logger.hpp"
 #include <cctype>
-#include <sstream>
 
-void IRCCore::cmdPass(Session& sess, const std::string& args)
+void IRCCore::cmdPass(Session& sess, const IrcMessage& msg)
 {
 	if (sess.isWelcomed())
 	{
 		replyNumeric(sess, "462", ":You may not reregister");
 		return;
 	}
-	if (args.empty())
-	{
-		replyNumeric(sess, "461", "PASS :Not enough parameters");
-		return;
-	}
-	if (args == _secret)
+	if (msg.params[0] == StrView(_secret))
 	{
 		sess.markPassOk(true);
-		std::cout << "[AUTH] FD " << sess.getSocket()
-			<< ": Password accepted" << std::endl;
+		Log(LOG_INFO) << "[AUTH] FD " << sess.getSocket()
+			<< ": Password accepted";
 	}
 	else
 		replyNumeric(sess, "464", ":Password incorrect");
 }
 
-void IRCCore::cmdNick(Session& sess, const std::string& args)
+void IRCCore::cmdNick(Session& sess, const IrcMessage& msg)
 {
-	if (args.empty())
+	if (msg.paramCount < 1 || msg.params[0].empty())
 	{
 		replyNumeric(sess, "431", ":No nickname given");
 		return;
@@ -38,10 +32,7 @@ void IRCCore::cmdNick(Session& sess, const std::string& args)
 		return;
 	}
 
-	std::string nick = args;
-	size_t sp = nick.find(' ');
-	if (sp != std::string::npos)
-		nick = nick.substr(0, sp);
+	std::string nick = msg.params[0].str();
 
 	if (!std::isalpha(nick[0]) && nick[0] != '[' && nick[0] != ']'
 		&& nick[0] != '\\' && nick[0] != '^' && nick[0] != '_'
@@ -71,8 +62,15 @@ void IRCCore::cmdNick(Session& sess, const std::string& args)
 	}
 
 	std::string prev = sess.getNick();
+	if (!prev.empty())
+		_nickIndex.erase(prev);
 	sess.setNick(nick);
-	std::cout << "[NICK] FD " << sess.getSocket() << ": " << nick << std::endl;
+	_nickIndex.set(nick, &sess);
+
+	const std::vector<Room*>& joined = sess.getRooms();
+	for (size_t i = 0; i < joined.size(); ++i)
+		joined[i]->renameUser(&sess);
+	Log(LOG_INFO) << "[NICK] FD " << sess.getSocket() << ": " << nick;
 
 	if (sess.isWelcomed() && !prev.empty())
 	{
@@ -80,46 +78,29 @@ void IRCCore::cmdNick(Session& sess, const std::string& args)
 			+ "@localhost NICK :" + nick + "\r\n";
 		enqueueReply(sess, note);
 
-		for (std::map<std::string, Room*>::iterator it = _rooms.begin();
-			it != _rooms.end(); ++it)
-		{
-			if (it->second->hasUser(&sess))
-				it->second->relay(note, &sess);
-		}
+		for (size_t i = 0; i < joined.size(); ++i)
+			joined[i]->relay(note, &sess);
 	}
 
 	tryFinalize(sess);
 }
 
-void IRCCore::cmdUser(Session& sess, const std::string& args)
+void IRCCore::cmdUser(Session& sess, const IrcMessage& msg)
 {
 	if (sess.isWelcomed())
 	{
 		replyNumeric(sess, "462", ":You may not reregister");
 		return;
 	}
-	if (args.empty())
-	{
-		replyNumeric(sess, "461", "USER :Not enough parameters");
-		return;
-	}
 	if (!sess.hasValidPass())
 	{
 		replyNumeric(sess, "464", ":Password incorrect - use PASS first");
 		return;
 	}
 
-	std::istringstream iss(args);
-    std::string username, mode, unused;
-    
-    if (!(iss >> username >> mode >> unused))
-    {
-        replyNumeric(sess, "461", "USER :Not enough parameters");
-        return;
-    }
-    
+    std::string username = msg.params[0].str();
     sess.setUser(username);
-    std::cout << "[USER] FD " << sess.getSocket() << ": " << username << std::endl;
+    Log(LOG_INFO) << "[USER] FD " << sess.getSocket() << ": " << username;
 
     tryFinalize(sess);
 }
@@ -137,47 +118,27 @@ void IRCCore::tryFinalize(Session& sess)
 		std::string welcome = ":Welcome to the " + _hostname + " Network, "
 			+ sess.getNick() + "!" + sess.getUser() + "@localhost";
 		replyNumeric(sess, "001", welcome);
+		sess.setNextPing(_clockMs + _config.timeouts.pingInterval * 1000L);
+		armTimer(sess);
 
-		std::cout << "[REGISTERED] " << sess.getNick()
-			<< " is now registered" << std::endl;
+		Log(LOG_INFO) << "[REGISTERED] " << sess.getNick()
+			<< " is now registered";
 	}
 }
 
-void IRCCore::cmdQuit(Session& sess, const std::string& args)
+void IRCCore::cmdQuit(Session& sess, const IrcMessage& msg)
 {
 	std::string reason = "Quit";
-	if (!args.empty())
-	{
-		reason = args;
-		if (reason[0] == ':')
-			reason = reason.substr(1);
-	}
+	if (msg.paramCount > 0)
+		reason = msg.rest(0).str();
 
 	std::string quitLine = buildPrefix(sess) + " QUIT :" + reason + "\r\n";
 
-	for (std::map<std::string, Room*>::iterator it = _rooms.begin();
-		it != _rooms.end(); ++it)
-	{
-		if (it->second->hasUser(&sess))
-			it->second->relay(quitLine, &sess);
-	}
-
-	// Refresh poll flags so QUIT messages are sent promptly
-	for (std::map<int, Session*>::iterator sit = _sessions.begin();
-		sit != _sessions.end(); ++sit)
-	{
-		if (sit->first != sess.getSocket())
-			refreshPollFlags(sit->first);
-	}
+	const std::vector<Room*>& joined = sess.getRooms();
+	for (size_t i = 0; i < joined.size(); ++i)
+		joined[i]->relay(quitLine, &sess);
 
-	std::cout << "[QUIT] " << sess.getNick() << ": " << reason << std::endl;
+	Log(LOG_INFO) << "[QUIT] " << sess.getNick() << ": " << reason;
 
-	for (size_t i = 1; i < _watchers.size(); ++i)
-	{
-		if (_watchers[i].fd == sess.getSocket())
-		{
-			dropConnection(i);
-			return;
-		}
-	}
+	dropConnection(sess.getSocket());
 }
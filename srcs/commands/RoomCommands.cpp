@@ -1,5 +1,5 @@
 #include "IRCCore.hpp"
-#include <iostream>
+#include "Logger.hpp"
 #include <sstream>
 
 void IRCCore::joinOneChannel(Session& sess, const std::string& roomLabel,
@@ -45,12 +45,14 @@ void IRCCore::joinOneChannel(Session& sess, const std::string& roomLabel,
 	{
 		room = new Room(roomLabel);
 		_rooms[roomLabel] = room;
-		room->promoteAdmin(&sess);
-		std::cout << "[CHANNEL] Created: " << roomLabel << std::endl;
+		Log(LOG_INFO) << "[CHANNEL] Created: " << roomLabel;
 	}
 
+	bool founder = room->getUserList().empty();
 	room->insertUser(&sess);
 	room->removeGuest(&sess);
+	if (founder)
+		room->promoteAdmin(&sess);
 
 	std::string joinLine = buildPrefix(sess) + " JOIN " + roomLabel + "\r\n";
 	room->relayAll(joinLine);
@@ -58,38 +60,48 @@ void IRCCore::joinOneChannel(Session& sess, const std::string& roomLabel,
 	if (!room->getSubject().empty())
 		replyNumeric(sess, "332", roomLabel + " :" + room->getSubject());
 
-	std::string namesList = "";
-	std::vector<Session*>& users = room->getUserList();
-	for (size_t i = 0; i < users.size(); ++i)
-	{
-		if (i > 0)
-			namesList += " ";
-		if (room->isAdmin(users[i]))
-			namesList += "@";
-		namesList += users[i]->getNick();
-	}
+	sendNames(sess, room);
 
-	replyNumeric(sess, "353", "= " + roomLabel + " :" + namesList);
-	replyNumeric(sess, "366", roomLabel + " :End of /NAMES list");
-
-	std::cout << "[JOIN] " << sess.getNick() << " joined "
-		<< roomLabel << std::endl;
+	Log(LOG_INFO) << "[JOIN] " << sess.getNick() << " joined "
+		<< roomLabel;
 }
 
-void IRCCore::cmdJoin(Session& sess, const std::string& args)
+// Splits the cached names list into 353 replies that fit the 512-byte line
+void IRCCore::sendNames(Session& sess, Room* room)
 {
-	if (args.empty())
+	const std::string& names = room->getNames();
+	std::string head = "= " + room->getLabel() + " :";
+	std::string nick = sess.getNick().empty() ? "*" : sess.getNick();
+	size_t fixed = 1 + _hostname.size() + 5 + nick.size() + 1 + head.size() + 2;
+	size_t budget = (fixed < 512) ? 512 - fixed : 0;
+
+	// names holds " tok tok ...": pos always sits on a separator
+	size_t pos = 0;
+	while (pos < names.size())
 	{
-		replyNumeric(sess, "461", "JOIN :Not enough parameters");
-		return;
+		size_t start = pos + 1;
+		size_t stop = names.find(' ', start);
+		if (stop == std::string::npos)
+			stop = names.size();
+		while (stop < names.size())
+		{
+			size_t next = names.find(' ', stop + 1);
+			if (next == std::string::npos)
+				next = names.size();
+			if (next - start > budget)
+				break;
+			stop = next;
+		}
+		replyNumeric(sess, "353", head + names.substr(start, stop - start));
+		pos = stop;
 	}
+	replyNumeric(sess, "366", room->getLabel() + " :End of /NAMES list");
+}
 
-	std::istringstream iss(args);
-	std::string chanGroup, keyGroup;
-	iss >> chanGroup >> keyGroup;
-
-	std::vector<std::string> chans = splitComma(chanGroup);
-	std::vector<std::string> keys = splitComma(keyGroup);
+void IRCCore::cmdJoin(Session& sess, const IrcMessage& msg)
+{
+	std::vector<std::string> chans = splitComma(msg.params[0]);
+	std::vector<std::string> keys = splitComma(msg.param(1));
 
 	for (size_t i = 0; i < chans.size(); ++i)
 	{
@@ -98,26 +110,10 @@ void IRCCore::cmdJoin(Session& sess, const std::string& args)
 	}
 }
 
-void IRCCore::cmdPart(Session& sess, const std::string& args)
+void IRCCore::cmdPart(Session& sess, const IrcMessage& msg)
 {
-	if (args.empty())
-	{
-		replyNumeric(sess, "461", "PART :Not enough parameters");
-		return;
-	}
-
-	std::string chanGroup = args;
-	std::string reason = "";
-	size_t sp = args.find(' ');
-	if (sp != std::string::npos)
-	{
-		chanGroup = args.substr(0, sp);
-		reason = args.substr(sp + 1);
-		if (!reason.empty() && reason[0] == ':')
-			reason = reason.substr(1);
-	}
-
-	std::vector<std::string> chans = splitComma(chanGroup);
+	std::string reason = msg.rest(1).str();
+	std::vector<std::string> chans = splitComma(msg.params[0]);
 
 	for (size_t i = 0; i < chans.size(); ++i)
 	{
@@ -137,49 +133,28 @@ void IRCCore::cmdPart(Session& sess, const std::string& args)
 		{
 			_rooms.erase(chans[i]);
 			delete room;
-			std::cout << "[CHANNEL] Deleted: " << chans[i] << std::endl;
+			Log(LOG_INFO) << "[CHANNEL] Deleted: " << chans[i];
 		}
 
-		std::cout << "[PART] " << sess.getNick() << " left "
-			<< chans[i] << std::endl;
+		Log(LOG_INFO) << "[PART] " << sess.getNick() << " left "
+			<< chans[i];
 	}
 }
 
-void IRCCore::cmdNames(Session& sess, const std::string& args)
+void IRCCore::cmdNames(Session& sess, const IrcMessage& msg)
 {
-    std::string roomLabel = args;
-    
-    if (!roomLabel.empty() && roomLabel[0] == ':')
-        roomLabel = roomLabel.substr(1);
-
-    if (roomLabel.empty())
-    {
-        replyNumeric(sess, "461", "NAMES :Not enough parameters");
-        return;
-    }
+    std::string roomLabel = msg.params[0].str();
 
     Room* room = requireRoom(sess, roomLabel, false);
     if (!room)
         return;
 
-    std::string namesList = "";
-    std::vector<Session*>& users = room->getUserList();
-    for (size_t i = 0; i < users.size(); ++i)
-    {
-        if (i > 0)
-            namesList += " ";
-        if (room->isAdmin(users[i]))
-            namesList += "@";
-        namesList += users[i]->getNick();
-    }
-
-    replyNumeric(sess, "353", "= " + roomLabel + " :" + namesList);
-    replyNumeric(sess, "366", roomLabel + " :End of /NAMES list");
+    sendNames(sess, room);
 }
 
-void IRCCore::cmdList(Session& sess, const std::string& args)
+void IRCCore::cmdList(Session& sess, const IrcMessage& msg)
 {
-    (void)args;
+    (void)msg;
 
     replyNumeric(sess, "321", "Channel :Users  Name");
 
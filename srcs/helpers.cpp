@@ -1,13 +1,15 @@
 #include "helpers.hpp"
+#include "Logger.hpp"
 #include <fcntl.h>
 #include <iostream>
 #include <cstdlib>
+#include <ctime>
 
 bool enable_nonblock(int fd)
 {
 	if (fcntl(fd, F_SETFL, O_NONBLOCK) == -1)
 	{
-		std::cerr << "fcntl: failed to set non-blocking" << std::endl;
+		Log(LOG_ERROR) << "fcntl: failed to set non-blocking";
 		return false;
 	}
 	return true;
@@ -15,6 +17,61 @@ bool enable_nonblock(int fd)
 
 void fatal(const std::string& msg)
 {
+	// Queued records would be lost on exit()
+	Logger::stop();
 	std::cerr << "Error: " << msg << std::endl;
 	exit(1);
 }
+
+long monotonicMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+unsigned long long monotonicNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+char ircFold(char c)
+{
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A' + 'a';
+	if (c == '[')
+		return '{';
+	if (c == ']')
+		return '}';
+	if (c == '\\')
+		return '|';
+	if (c == '~')
+		return '^';
+	return c;
+}
+
+// FNV-1a over the folded bytes, so no lower-cased copy is built
+size_t NickTraits::hash(const std::string& nick)
+{
+	size_t h = 2166136261u;
+	for (size_t i = 0; i < nick.size(); ++i)
+	{
+		h ^= static_cast<unsigned char>(ircFold(nick[i]));
+		h *= 16777619u;
+	}
+	return h;
+}
+
+bool NickTraits::equal(const std::string& a, const std::string& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		if (ircFold(a[i]) != ircFold(b[i]))
+			return false;
+	}
+	return true;
+}
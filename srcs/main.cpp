@@ -1,4 +1,5 @@
 #include "IRCCore.hpp"
+#include "Config.hpp"
 #include <iostream>
 #include <cstdlib>
 #include <csignal>
@@ -19,9 +20,9 @@ static bool checkPort(const char* str)
 
 int main(int argc, char** argv)
 {
-	if (argc != 3)
+	if (argc < 3)
 	{
-		std::cerr << "Usage: " << argv[0] << " <port> <password>" << std::endl;
+		printServerOptions(argv[0]);
 		return 1;
 	}
 
@@ -38,20 +39,30 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	ServerConfig cfg;
+	if (!parseServerOptions(argc, argv, 3, cfg))
+	{
+		printServerOptions(argv[0]);
+		return 1;
+	}
+
 	signal(SIGINT, sig_catch);
 	signal(SIGTERM, sig_catch);
 	signal(SIGQUIT, sig_catch);
 
+	Logger::start(cfg.logLevel);
 	try
 	{
-		IRCCore core(std::atoi(argv[1]), secret);
+		IRCCore core(std::atoi(argv[1]), secret, cfg);
 		core.loop();
 	}
 	catch (const std::exception& e)
 	{
+		Logger::stop();
 		std::cerr << "Exception: " << e.what() << std::endl;
 		return 1;
 	}
+	Logger::stop();
 
 	return 0;
 }
@@ -7,6 +7,8 @@ IRCSERV="./ircserv"
 PASS_COUNT=0
 FAIL_COUNT=0
 SERVER_PID=""
+OPT_PORT=6668
+OPT_PID=""
 
 GREEN="\033[0;32m"
 RED="\033[0;31m"
@@ -24,6 +26,10 @@ cleanup() {
         kill "$SERVER_PID" 2>/dev/null
         wait "$SERVER_PID" 2>/dev/null
     fi
+    if [ -n "$OPT_PID" ]; then
+        kill "$OPT_PID" 2>/dev/null
+        wait "$OPT_PID" 2>/dev/null
+    fi
     rm -f /tmp/irc_*.log
 }
 trap cleanup EXIT
@@ -64,6 +70,34 @@ start_server() {
     fi
 }
 
+# Serveur secondaire pour les tests qui ont besoin d'options :
+# start_option_server <options...>, puis PORT=$OPT_PORT send_recv_output ...
+start_option_server() {
+    $IRCSERV $OPT_PORT $PASS "$@" > /tmp/irc_option_server.log 2>&1 &
+    OPT_PID=$!
+    sleep 0.5
+}
+
+stop_option_server() {
+    kill "$OPT_PID" 2>/dev/null
+    wait "$OPT_PID" 2>/dev/null
+    OPT_PID=""
+}
+
+# Envoie $1 au serveur secondaire puis lit jusqu'à ce qu'il ferme, $2 secondes au plus :
+# la sortie se termine par FERME ou OUVERT
+recv_until_closed() {
+    (
+        # Le serveur a pu fermer avant l'envoi : pas de SIGPIPE
+        trap '' PIPE
+        exec 3<>/dev/tcp/"$SERVER"/"$OPT_PORT" 2>/dev/null || exit 1
+        printf "$1" >&3
+        timeout "$2" cat <&3
+        if [ $? -eq 124 ]; then echo "OUVERT"; else echo "FERME"; fi
+        exec 3>&- 3<&-
+    ) 2>/dev/null
+}
+
 # ─────────────────────────────────────────
 section "Compilation"
 # ─────────────────────────────────────────
@@ -250,6 +284,45 @@ else
     info "PRIVMSG avec virgules : destinataires introuvables (normal si déconnectés)"
 fi
 
+# ─────────────────────────────────────────
+section "Pseudos insensibles à la casse"
+# ─────────────────────────────────────────
+
+# Foo reste connecté : foo doit être refusé, et FOO doit l'atteindre
+(
+    tmpout="/tmp/irc_case_${BASHPID}.log"
+    exec 3<>/dev/tcp/"$SERVER"/"$PORT" 2>/dev/null || exit 1
+    cat <&3 > "$tmpout" &
+    cat_pid=$!
+    sleep 0.1
+    printf "PASS $PASS\r\nNICK Foo\r\nUSER foo 0 * :Foo\r\n" >&3
+    sleep 2.5
+    exec 3>&- 3<&-
+    sleep 0.1
+    kill $cat_pid 2>/dev/null
+    wait $cat_pid 2>/dev/null
+    cat "$tmpout"
+    rm -f "$tmpout"
+) > /tmp/irc_case.log 2>/dev/null &
+CASE_PID=$!
+sleep 0.5
+
+OUT=$(send_recv_output "PASS $PASS\r\nNICK foo\r\nUSER foo2 0 * :Foo2\r\n" 0.5)
+if echo "$OUT" | grep -q "433"; then
+    ok "NICK foo alors que Foo est pris → 433 refusé"
+else
+    fail "NICK foo accepté alors que Foo est pris (attendu 433)"
+fi
+
+send_and_recv "PASS $PASS\r\nNICK casesender\r\nUSER casesender 0 * :CaseSender\r\nPRIVMSG FOO :bonjour en majuscules\r\n" 0.5
+wait $CASE_PID 2>/dev/null
+
+if grep -q "bonjour en majuscules" /tmp/irc_case.log; then
+    ok "PRIVMSG FOO délivré à Foo"
+else
+    fail "PRIVMSG FOO non délivré à Foo"
+fi
+
 # ─────────────────────────────────────────
 section "Commandes opérateur"
 # ─────────────────────────────────────────
@@ -470,6 +543,48 @@ else
     fail "Seulement $CONNECTED/5 connexions simultanées acceptées"
 fi
 
+# ─────────────────────────────────────────
+section "NAMES découpé sur plusieurs lignes (353)"
+# ─────────────────────────────────────────
+
+# 40 membres aux pseudos longs : la liste dépasse largement 512 octets
+PIDS=()
+for i in $(seq 1 40); do
+    (
+        exec 3<>/dev/tcp/"$SERVER"/"$PORT" 2>/dev/null || exit 1
+        cat <&3 > /dev/null &
+        cat_pid=$!
+        printf "PASS $PASS\r\nNICK membre_au_pseudo_plutot_long_$i\r\nUSER split$i 0 * :Split\r\nJOIN #namesplit\r\n" >&3
+        sleep 3
+        exec 3>&- 3<&-
+        kill $cat_pid 2>/dev/null
+    ) > /dev/null 2>&1 &
+    PIDS+=($!)
+done
+sleep 1
+
+OUT=$(send_recv_output "PASS $PASS\r\nNICK splitcheck\r\nUSER splitcheck 0 * :SplitCheck\r\nJOIN #namesplit\r\n" 1)
+
+for pid in "${PIDS[@]}"; do
+    kill $pid 2>/dev/null
+    wait $pid 2>/dev/null
+done
+
+LINES_353=$(echo "$OUT" | grep -c " 353 ")
+LONG_353=$(echo "$OUT" | grep " 353 " | awk '{ if (length($0) + 1 > 512) n++ } END { print n + 0 }')
+COUNT_366=$(echo "$OUT" | grep -c " 366 ")
+MEMBERS=$(echo "$OUT" | grep " 353 " | sed 's/^[^:]*:[^:]*://' | tr -d '\r' | wc -w)
+if [ "$LINES_353" -ge 2 ] && [ "$LONG_353" -eq 0 ]; then
+    ok "NAMES réparti sur $LINES_353 lignes 353 de 512 octets au plus"
+else
+    fail "NAMES mal découpé ($LINES_353 lignes 353, $LONG_353 de plus de 512 octets)"
+fi
+if [ "$COUNT_366" -eq 1 ] && [ "$MEMBERS" -eq 41 ]; then
+    ok "Un seul 366 après la liste complète ($MEMBERS membres)"
+else
+    fail "Fin de NAMES incorrecte ($COUNT_366 lignes 366, $MEMBERS membres sur 41)"
+fi
+
 # ─────────────────────────────────────────
 section "INVITE"
 # ─────────────────────────────────────────
@@ -627,6 +742,113 @@ else
     fail "Serveur non opérationnel après flood + client suspendu"
 fi
 
+# ─────────────────────────────────────────
+section "Contrôle de flood (--flood-burst)"
+# ─────────────────────────────────────────
+
+start_option_server --flood-burst 5 --flood-rate 20
+
+# 30 PING d'un coup : l'excédent est différé, pas rejeté
+BURST=""
+for i in $(seq 1 30); do
+    BURST="${BURST}PING :rafale$i\r\n"
+done
+OUT=$(PORT=$OPT_PORT send_recv_output "PASS $PASS\r\nNICK burster\r\nUSER burster 0 * :Burster\r\n$BURST" 2.5)
+PONGS=$(echo "$OUT" | grep -c "PONG")
+if [ "$PONGS" -eq 30 ] && ! echo "$OUT" | grep -q "ERROR"; then
+    ok "Rafale au-delà de --flood-burst traitée en entier (30 PONG), sans déconnexion"
+else
+    fail "Rafale au-delà de --flood-burst mal traitée ($PONGS PONG sur 30)"
+fi
+
+# Plus de 8 Ko en attente pendant que le client est bridé
+FLOOD=""
+PADDING=$(printf "%0200d" 0)
+for i in $(seq 1 60); do
+    FLOOD="${FLOOD}PING :$PADDING\r\n"
+done
+OUT=$(PORT=$OPT_PORT send_recv_output "PASS $PASS\r\nNICK excess\r\nUSER excess 0 * :Excess\r\n$FLOOD" 1)
+if echo "$OUT" | grep -q "ERROR :Closing Link.*(Excess Flood)"; then
+    ok "Plus de 8 Ko différés → ERROR :Closing Link (Excess Flood)"
+else
+    fail "Dépassement du tampon de réception non sanctionné (attendu Excess Flood)"
+fi
+
+stop_option_server
+
+# ─────────────────────────────────────────
+section "Délais d'inscription et de PING"
+# ─────────────────────────────────────────
+
+start_option_server --register-timeout 1 --ping-interval 1 --ping-timeout 1
+
+OUT=$(recv_until_closed "PASS $PASS\r\n" 4)
+if echo "$OUT" | tail -1 | grep -q "FERME"; then
+    ok "Client resté sur PASS fermé après --register-timeout 1"
+else
+    fail "Client non inscrit toujours connecté après --register-timeout 1"
+fi
+
+OUT=$(recv_until_closed "PASS $PASS\r\nNICK nopong\r\nUSER nopong 0 * :NoPong\r\n" 5)
+if echo "$OUT" | grep -q "PING" && echo "$OUT" | tail -1 | grep -q "FERME"; then
+    ok "Client sans PONG déconnecté (--ping-interval 1 --ping-timeout 1)"
+else
+    fail "Client sans PONG toujours connecté (attendu Ping timeout)"
+fi
+
+stop_option_server
+
+# ─────────────────────────────────────────
+section "Limite de connexions par adresse (--max-per-ip)"
+# ─────────────────────────────────────────
+
+# Deux connexions restent ouvertes pendant que la troisième essaie
+hold_two_connections() {
+    HOLD_PIDS=()
+    for i in 1 2; do
+        (
+            exec 3<>/dev/tcp/"$SERVER"/"$OPT_PORT" 2>/dev/null || exit 1
+            sleep 3
+            exec 3>&- 3<&-
+        ) 2>/dev/null &
+        HOLD_PIDS+=($!)
+    done
+    sleep 0.3
+}
+
+release_two_connections() {
+    for pid in "${HOLD_PIDS[@]}"; do
+        kill $pid 2>/dev/null
+        wait $pid 2>/dev/null
+    done
+}
+
+start_option_server --max-per-ip 2
+hold_two_connections
+# Refusée dès l'accept : elle n'a rien à envoyer
+OUT=$(recv_until_closed "" 2)
+release_two_connections
+stop_option_server
+
+if echo "$OUT" | grep -q "ERROR :Closing Link.*(Too many connections from your host)" \
+    && echo "$OUT" | tail -1 | grep -q "FERME"; then
+    ok "3e connexion depuis la même adresse → ERROR et fermeture (--max-per-ip 2)"
+else
+    fail "3e connexion depuis la même adresse non refusée (--max-per-ip 2)"
+fi
+
+start_option_server --max-per-ip 2 --exempt 127.0.0.1
+hold_two_connections
+OUT=$(recv_until_closed "PASS $PASS\r\nNICK exemptconn\r\nUSER exemptconn 0 * :Exempt\r\n" 1)
+release_two_connections
+stop_option_server
+
+if echo "$OUT" | grep -q "001" && ! echo "$OUT" | grep -q "ERROR"; then
+    ok "3e connexion acceptée pour une adresse exemptée (--exempt 127.0.0.1)"
+else
+    fail "3e connexion refusée malgré --exempt 127.0.0.1"
+fi
+
 # ─────────────────────────────────────────
 section "Fuites mémoire (valgrind)"
 # ─────────────────────────────────────────